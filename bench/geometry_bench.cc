@@ -0,0 +1,139 @@
+// mat4×vec4与mat4×mat4的微基准测试，比较三种实现：
+//   SMatrix4f/Vector4f    SSE特化(geometry.h)
+//   SMatrix4/Vector4      通用模板的double版本，渲染器目前使用的类型
+//   float标量             与通用模板相同的三重循环，作为SSE特化的对照
+// 每种实现对同一组随机数据重复计算，取最短一轮的平均每次运算耗时。
+//
+// 在仓库根目录编译运行：
+//   g++ -std=c++17 -O2 -I. bench/geometry_bench.cc src/geometry.cc
+//     -o geometry_bench
+//   ./geometry_bench [重复轮数]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "include/geometry.h"
+
+namespace {
+// 每轮运算的次数，数据量为几百KB，大多可以留在L2缓存中
+const int kOpNum = 1024;
+const int kRepeatNum = 200;
+
+struct ScalarMatrix4f {
+  float m[4][4];
+};
+
+struct ScalarVector4f {
+  float v[4];
+};
+
+ScalarVector4f operator*(const ScalarMatrix4f& lhs, const ScalarVector4f& rhs) {
+  ScalarVector4f res;
+  for (int i = 0; i < 4; ++i) {
+    float value = 0;
+    for (int j = 0; j < 4; ++j) value += lhs.m[i][j] * rhs.v[j];
+    res.v[i] = value;
+  }
+  return res;
+}
+
+ScalarMatrix4f operator*(const ScalarMatrix4f& lhs, const ScalarMatrix4f& rhs) {
+  ScalarMatrix4f res;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      float value = 0;
+      for (int k = 0; k < 4; ++k) value += lhs.m[i][k] * rhs.m[k][j];
+      res.m[i][j] = value;
+    }
+  }
+  return res;
+}
+
+void Set(SMatrix4f* m, int i, int j, float value) { (*m)(i, j) = value; }
+void Set(SMatrix4* m, int i, int j, float value) { (*m)(i, j) = value; }
+void Set(ScalarMatrix4f* m, int i, int j, float value) { m->m[i][j] = value; }
+void Set(Vector4f* v, int i, float value) { (*v)[i] = value; }
+void Set(Vector4* v, int i, float value) { (*v)[i] = value; }
+void Set(ScalarVector4f* v, int i, float value) { v->v[i] = value; }
+
+float Get(const Vector4f& v) { return v[0] + v[1] + v[2] + v[3]; }
+float Get(const Vector4& v) { return v[0] + v[1] + v[2] + v[3]; }
+float Get(const ScalarVector4f& v) { return v.v[0] + v.v[1] + v.v[2] + v.v[3]; }
+float Get(const SMatrix4f& m) { return m(0, 0) + m(1, 1) + m(2, 2) + m(3, 3); }
+float Get(const SMatrix4& m) { return m(0, 0) + m(1, 1) + m(2, 2) + m(3, 3); }
+float Get(const ScalarMatrix4f& m) {
+  return m.m[0][0] + m.m[1][1] + m.m[2][2] + m.m[3][3];
+}
+
+// 对lhs[i] * rhs[i]计时
+// @param checksum 累加结果，防止计算被优化掉
+// @return 最短一轮中每次乘法的耗时，单位为纳秒
+template <typename Lhs, typename Rhs>
+double TimeMultiply(int rounds, float* checksum) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-1, 1);
+  std::vector<Lhs> lhs(kOpNum);
+  std::vector<Rhs> rhs(kOpNum);
+  for (int n = 0; n < kOpNum; ++n) {
+    for (int i = 0; i < 4; ++i) {
+      for (int j = 0; j < 4; ++j) Set(&lhs[n], i, j, dist(rng));
+    }
+    if constexpr (std::is_same<Lhs, Rhs>::value) {
+      for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) Set(&rhs[n], i, j, dist(rng));
+      }
+    } else {
+      for (int i = 0; i < 4; ++i) Set(&rhs[n], i, dist(rng));
+    }
+  }
+  std::vector<decltype(lhs[0] * rhs[0])> out(kOpNum);
+  double best = 1e30;
+  for (int round = 0; round < rounds; ++round) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < kRepeatNum; ++repeat) {
+      for (int n = 0; n < kOpNum; ++n) out[n] = lhs[n] * rhs[n];
+      // 每次重复前改动一个输入，编译器不能把重复的计算合并为一次
+      rhs[repeat % kOpNum] = rhs[(repeat + 1) % kOpNum];
+    }
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::nano>(end - begin)
+                            .count() /
+                        (static_cast<double>(kOpNum) * kRepeatNum));
+    for (int n = 0; n < kOpNum; ++n) *checksum += Get(out[n]);
+  }
+  return best;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int rounds = 1 < argc ? std::atoi(argv[1]) : 20;
+  if (0 >= rounds) {
+    std::cerr << "Invalid round count " << argv[1] << ".\n";
+    return 1;
+  }
+  float checksum = 0;
+  std::cout << "mat4 x vec4 (ns/op)\n"
+            << "  SMatrix4f SSE:  "
+            << TimeMultiply<SMatrix4f, Vector4f>(rounds, &checksum) << "\n"
+            << "  SMatrix4:       "
+            << TimeMultiply<SMatrix4, Vector4>(rounds, &checksum) << "\n"
+            << "  float scalar:   "
+            << TimeMultiply<ScalarMatrix4f, ScalarVector4f>(rounds, &checksum)
+            << "\n";
+  std::cout << "mat4 x mat4 (ns/op)\n"
+            << "  SMatrix4f SSE:  "
+            << TimeMultiply<SMatrix4f, SMatrix4f>(rounds, &checksum) << "\n"
+            << "  SMatrix4:       "
+            << TimeMultiply<SMatrix4, SMatrix4>(rounds, &checksum) << "\n"
+            << "  float scalar:   "
+            << TimeMultiply<ScalarMatrix4f, ScalarMatrix4f>(rounds, &checksum)
+            << "\n";
+  // 校验和没有意义，输出它只是为了让结果被使用
+  std::cout << "checksum: " << checksum << "\n";
+  return 0;
+}
@@ -0,0 +1,131 @@
+// 片元着色开销的基准测试：同一场景分别以IShader*(虚函数调用)和
+// TextureShader(按静态类型实例化，fragment_process内联)调用
+// Rasterizer::Flush，比较每个片元的平均耗时(Flush的总耗时除以着色的
+// 片元数，含覆盖与深度测试，两种方式只有片元着色的调用方式不同)。
+// 光栅化器不使用线程池，在单线程中测量；图元装配不计入时间。
+// 两种方式交替运行，各取最短的一次，减小频率变化等干扰。
+//
+// 在仓库根目录编译运行：
+//   g++ -std=c++17 -O2 -I. bench/shader_bench.cc $(ls src/*.cc | grep -v main)
+//     -o shader_bench -pthread
+//   ./shader_bench [obj文件] [纹理文件] [重复次数]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "include/framebuffer.h"
+#include "include/geometry.h"
+#include "include/indexed_mesh.h"
+#include "include/model.h"
+#include "include/primitive_assembler.h"
+#include "include/profiler.h"
+#include "include/rasterizer.h"
+#include "include/shader.h"
+#include "include/texture.h"
+#include "include/thread_pool.h"
+#include "include/vertex_stage.h"
+
+namespace {
+const int kWidth = 800;
+const int kHeight = 800;
+
+// 把网格的所有三角形装配后提交给光栅化器
+void Submit(const IndexedMesh& mesh, const VertexStage& vertex_stage,
+            PrimitiveAssembler* assembler, Rasterizer* rasterizer) {
+  const std::vector<std::uint32_t>& indices = mesh.GetIndices();
+  Triangle triangle;
+  for (std::size_t i = 0; i < indices.size(); i += 3) {
+    for (int k = 0; k < 3; ++k) {
+      int index = indices[i + k];
+      const double* uv = mesh.GetVertex(index).texture_coordinates;
+      triangle.vertices[k] = vertex_stage.GetClipVertex(index);
+      triangle.texture_coordinates[k] = Vector2{uv[0], uv[1]};
+    }
+    assembler->Assemble(triangle, rasterizer);
+  }
+}
+
+// @return 一次Flush的耗时，单位为秒
+template <typename Shader>
+double TimeFlush(const IndexedMesh& mesh, const VertexStage& vertex_stage,
+                 PrimitiveAssembler* assembler, Rasterizer* rasterizer,
+                 Shader* shader) {
+  rasterizer->Clear();
+  Submit(mesh, vertex_stage, assembler, rasterizer);
+  auto begin = std::chrono::steady_clock::now();
+  rasterizer->Flush(shader);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string obj_filename =
+      1 < argc ? argv[1] : "/home/tea/my-renderer/obj/african_head.obj";
+  std::string texture_filename =
+      2 < argc ? argv[2]
+               : "/home/tea/my-renderer/obj/african_head_diffuse.tga";
+  int runs = 3 < argc ? std::atoi(argv[3]) : 15;
+  if (0 >= runs) {
+    std::cerr << "Invalid run count " << argv[3] << ".\n";
+    return 1;
+  }
+
+  ObjModel model(obj_filename, &ThreadPool::Global());
+  if (0 == model.GetFaceNum()) {
+    std::cerr << "Can't load model " << obj_filename << ".\n";
+    return 1;
+  }
+  IndexedMesh mesh(model);
+  Texture texture = LoadTexture(texture_filename, &ThreadPool::Global());
+  ColorBuffer canvas(kWidth, kHeight);
+  TextureShader shader(&texture);
+  shader.RegisterCanvas(&canvas);
+  shader.LookAt(Vector3{-2, 0, 2}, Vector3{1, 0, -1}, Vector3{0, 1, 0});
+  shader.Projection(-1.5);
+  VertexStage vertex_stage(mesh, &ThreadPool::Global());
+  vertex_stage.Process(shader.GetMvp());
+
+  Rasterizer rasterizer(kWidth, kHeight, nullptr);
+  PrimitiveAssembler assembler(kWidth, kHeight);
+  assembler.SetCullMode(PrimitiveAssembler::kCullBack);
+  assembler.SetFrontFace(PrimitiveAssembler::kCounterClockwise);
+
+  // 片元数只在Profiler开启时统计，先单独渲染一次计数，计时时关闭
+  Profiler::Global().SetEnabled(true);
+  rasterizer.Clear();
+  Submit(mesh, vertex_stage, &assembler, &rasterizer);
+  rasterizer.Flush(&shader);
+  long long fragment_num = rasterizer.GetStats().depth_passed;
+  Profiler::Global().SetEnabled(false);
+  if (0 >= fragment_num) {
+    std::cerr << "No fragment was shaded.\n";
+    return 1;
+  }
+
+  IShader* virtual_shader = &shader;
+  double virtual_seconds = 1e30;
+  double inline_seconds = 1e30;
+  for (int run = 0; run < runs; ++run) {
+    virtual_seconds = std::min(
+        virtual_seconds, TimeFlush(mesh, vertex_stage, &assembler, &rasterizer,
+                                   virtual_shader));
+    inline_seconds = std::min(
+        inline_seconds,
+        TimeFlush(mesh, vertex_stage, &assembler, &rasterizer, &shader));
+  }
+  shader.UnregisterCanvas();
+
+  std::cout << "fragments: " << fragment_num << ", runs: " << runs
+            << " (best of)\n";
+  std::cout << "IShader (virtual):       " << virtual_seconds * 1e3
+            << " ms, " << virtual_seconds * 1e9 / fragment_num
+            << " ns/fragment\n";
+  std::cout << "TextureShader (inlined): " << inline_seconds * 1e3 << " ms, "
+            << inline_seconds * 1e9 / fragment_num << " ns/fragment\n";
+  return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef BATCH_RENDERER_H_
+#define BATCH_RENDERER_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "include/frame_writer.h"
+#include "include/framebuffer.h"
+#include "include/geometry.h"
+#include "include/image_encoder.h"
+#include "include/indexed_mesh.h"
+#include "include/texture.h"
+#include "include/thread_pool.h"
+
+// 一个视角的相机参数，含义同TextureShader::LookAt
+struct Camera {
+  Vector3 position;
+  Vector3 gaze_direction;
+  Vector3 up;
+};
+
+// 解析"px,py,pz,gx,gy,gz,ux,uy,uz"形式的相机参数
+// @return 不是9个数时返回false
+bool ParseCamera(const std::string& text, Camera* camera);
+// 从文本文件读取相机列表，每行一个相机，9个数以空格或逗号分隔，
+// 空行和#开头的行被忽略
+// @return 文件无法打开或有格式错误的行时返回false
+bool ReadCameraFile(const std::string& filename,
+                    std::vector<Camera>* cameras);
+
+// 批量渲染同一模型的多个视角。
+// 网格与纹理只加载一次，由所有帧只读共享。每帧作为线程池上的一个任务
+// 整体在一个线程中完成(顶点处理、光栅化)，帧之间并行，
+// 没有帧内的同步开销。每帧用到的光栅化器(含深度缓冲)、
+// 顶点处理结果等放在帧上下文中，从池中取用、用完归还，
+// 池的大小等于同时进行的帧数，与帧的总数无关。
+// 画好的画布交给FrameWriter在后台写出，渲染下一帧不等待磁盘。
+class BatchRenderer {
+ public:
+  // 一次Render的统计
+  struct Stats {
+    // 成功写出的帧数
+    int frames = 0;
+    // Render的总耗时，包括等待最后的帧写完
+    double seconds = 0;
+    // 各帧渲染时间之和，不含写文件
+    double render_seconds = 0;
+    FrameWriter::Stats writer;
+  };
+
+  // @param mesh, texture 不转移所有权，生存期需长于BatchRenderer
+  BatchRenderer(const IndexedMesh* mesh, const Texture* texture, int width,
+                int height, ThreadPool* pool);
+  BatchRenderer(const BatchRenderer& renderer) = delete;
+  BatchRenderer& operator=(const BatchRenderer& rhs) = delete;
+  ~BatchRenderer();
+
+  // 为每个相机渲染一帧，第i帧写入filename_prefix + i(4位补零) + "."
+  // + 编码器的扩展名
+  Stats Render(const std::vector<Camera>& cameras,
+               const std::string& filename_prefix);
+  // 目前为止创建的帧上下文数
+  int GetFramePoolSize() const;
+  // 默认输出不压缩的TGA
+  // @param encoder 不转移所有权，生存期需长于BatchRenderer
+  void SetEncoder(const ImageEncoder* encoder) { encoder_ = encoder; }
+
+ private:
+  struct Frame;
+
+  // 后台写线程数，写文件以等待I/O为主，不占用线程池
+  static constexpr int kWriterThreadNum = 1;
+  // 每个写线程对应的画布数：一块正在转换，其余在队列中等待
+  static constexpr int kBuffersPerWriter = 2;
+
+  // 取一个空闲的帧上下文，没有时新建
+  Frame* AcquireFrame();
+  void ReleaseFrame(Frame* frame);
+  // @param index 帧号，用于Profiler的统计
+  void RenderFrame(const Camera& camera, int index, Frame* frame,
+                   ColorBuffer* canvas) const;
+
+  const IndexedMesh* mesh_;
+  const Texture* texture_;
+  int width_;
+  int height_;
+  ThreadPool* pool_;
+  TgaEncoder default_encoder_;
+  const ImageEncoder* encoder_ = &default_encoder_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Frame>> frames_;
+  std::vector<Frame*> free_frames_;
+};
+
+#endif  // BATCH_RENDERER_H_
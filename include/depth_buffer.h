@@ -0,0 +1,70 @@
+#ifndef DEPTH_BUFFER_H_
+#define DEPTH_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// 以紧凑格式存放的分块深度缓冲。
+// 按tile主序存放，每个tile占连续的kTileSize*kTileSize个元素，
+// 与光栅化器的分块一致。光栅化一个tile时先LoadTile解码到工作缓冲，
+// 完成后StoreTile编码写回，每帧每个像素只读写一次紧凑格式。
+// Clear只设置每个tile的清除标志(O(tile数))，被标记的tile在下一次
+// LoadTile时直接填充清除值而不读取内存，没有三角形覆盖的tile不会被访问。
+// 深度越大越近，解码后的清除值为kClearDepth(负无穷)。
+class DepthBuffer {
+ public:
+  enum Format {
+    // IEEE单精度浮点
+    kFloat32 = 0,
+    // 24位定点，占32位(高8位不用)；[-1,1]均匀量化，0保留为清除值
+    kUnorm24 = 1,
+    // 16位定点，量化方式同kUnorm24
+    kUnorm16 = 2,
+  };
+  static constexpr int kTileSize = 64;
+  static constexpr int kTilePixels = kTileSize * kTileSize;
+  static constexpr double kClearDepth =
+      -std::numeric_limits<double>::infinity();
+
+  DepthBuffer(int width, int height, Format format);
+  DepthBuffer(const DepthBuffer& buffer) = delete;
+  DepthBuffer& operator=(const DepthBuffer& rhs) = delete;
+  ~DepthBuffer();
+
+  Format GetFormat() const { return format_; }
+  int GetTileNum() const { return tiles_x_ * tiles_y_; }
+  // 每个像素占用的字节数
+  int GetBytesPerPixel() const;
+  // 整个缓冲占用的字节数
+  std::size_t GetSize() const;
+
+  // 标记所有tile为已清除
+  void Clear();
+  bool IsTileCleared(int tile_index) const {
+    return 0 != cleared_[tile_index];
+  }
+  // 把一个tile解码为行主序的kTilePixels个深度值
+  void LoadTile(int tile_index, double* depth) const;
+  // 把LoadTile得到的工作缓冲编码写回，并清除该tile的清除标志。
+  // 不同tile可以在不同线程中同时读写
+  void StoreTile(int tile_index, const double* depth);
+  // 解码后的(x, y)处深度，用于调试与后处理
+  double GetDepth(int x, int y) const;
+
+ private:
+  int width_;
+  int height_;
+  int tiles_x_;
+  int tiles_y_;
+  Format format_;
+  // 按格式只使用其中一个
+  std::vector<float> float_data_;
+  std::vector<std::uint32_t> unorm24_data_;
+  std::vector<std::uint16_t> unorm16_data_;
+  // 用unsigned char而非vector<bool>，不同tile的标志可以并发写
+  std::vector<unsigned char> cleared_;
+};
+
+#endif  // DEPTH_BUFFER_H_
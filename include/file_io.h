@@ -0,0 +1,18 @@
+#ifndef FILE_IO_H_
+#define FILE_IO_H_
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+// 写出全部iovec，处理被信号中断、部分写入以及iovec数超过IOV_MAX的情况，
+// 各iovec的起点与长度会被修改
+// @return 写出失败或没有任何进展时返回false，errno表明原因
+bool WriteAll(int fd, iovec* iov, int iov_num);
+
+// 打开(创建或截断)文件并用writev写出全部数据，filename为"-"时写到标准输出
+// @return 打开或写出失败时输出错误信息并返回false
+bool WriteFile(const std::string& filename, std::vector<iovec>* iov);
+
+#endif  // FILE_IO_H_
@@ -0,0 +1,73 @@
+#ifndef FRAME_WRITER_H_
+#define FRAME_WRITER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/framebuffer.h"
+#include "include/image_encoder.h"
+
+// 异步输出队列。
+// 持有固定数量的画布，渲染端Acquire一块画布绘制，Submit后由后台写线程
+// 转换到线程自己的TgaImage，画布随即回到空闲列表供下一帧使用，
+// 之后再由编码器写成文件。渲染与写文件重叠，只有全部画布都在等待转换时
+// Acquire才会阻塞，在途的帧数与内存占用不超过画布数加写线程数。
+class FrameWriter {
+ public:
+  // 自构造以来的统计
+  struct Stats {
+    int frames_written = 0;
+    int frames_failed = 0;
+    // 写线程写文件的累计时间
+    double write_seconds = 0;
+    // 渲染端在Acquire中等待空闲画布的累计时间，即渲染被写文件拖慢的时间
+    double stall_seconds = 0;
+  };
+
+  // @param buffer_num 画布数，至少为1
+  // @param thread_num 写线程数，至少为1
+  // @param encoder 不转移所有权，生存期需长于FrameWriter
+  FrameWriter(int width, int height, int buffer_num, int thread_num,
+              const ImageEncoder* encoder);
+  FrameWriter(const FrameWriter& writer) = delete;
+  FrameWriter& operator=(const FrameWriter& rhs) = delete;
+  // 写完所有已提交的帧后结束写线程
+  ~FrameWriter();
+
+  // 取一块空闲画布，内容为上一次使用时的像素
+  ColorBuffer* Acquire();
+  // 把Acquire得到的画布交给写线程，之后渲染端不能再访问该画布
+  // @param frame 写文件的耗时记入Profiler的该帧
+  void Submit(ColorBuffer* canvas, const std::string& filename, int frame);
+  // 等待已提交的帧全部写完
+  void Wait();
+  Stats GetStats() const;
+
+ private:
+  struct Job {
+    ColorBuffer* canvas;
+    std::string filename;
+    int frame;
+  };
+
+  void WriterLoop();
+
+  std::vector<std::unique_ptr<ColorBuffer>> buffers_;
+  std::vector<std::thread> threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<ColorBuffer*> free_buffers_;
+  std::deque<Job> jobs_;
+  // 已被写线程取走但尚未写完的帧数
+  int writing_ = 0;
+  const ImageEncoder* encoder_;
+  bool stop_ = false;
+  Stats stats_;
+};
+
+#endif  // FRAME_WRITER_H_
@@ -0,0 +1,156 @@
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+// 帧缓冲的像素格式。
+// 每种格式提供FromColor(由着色器输出的TgaColor转换)与ToTga(写出
+// kTgaFormat字节的TGA像素)。kTgaLayout为true的格式内存布局与TGA文件
+// 相同(BGR[A]顺序)，转换为TgaImage时整行复制。
+struct PixelR8 {
+  std::uint8_t value;
+
+  static constexpr TgaImage::Format kTgaFormat = TgaImage::kGrayscale;
+  static constexpr bool kTgaLayout = true;
+  // 与TgaImage::SetColor写入灰度图的行为一致，取颜色的第一个字节
+  static PixelR8 FromColor(const TgaColor& color) {
+    return PixelR8{static_cast<std::uint8_t>(color.b)};
+  }
+  void ToTga(std::uint8_t* dst) const { dst[0] = value; }
+};
+
+struct PixelRgb8 {
+  std::uint8_t b;
+  std::uint8_t g;
+  std::uint8_t r;
+
+  static constexpr TgaImage::Format kTgaFormat = TgaImage::kRGB;
+  static constexpr bool kTgaLayout = true;
+  static PixelRgb8 FromColor(const TgaColor& color) {
+    return PixelRgb8{static_cast<std::uint8_t>(color.b),
+                     static_cast<std::uint8_t>(color.g),
+                     static_cast<std::uint8_t>(color.r)};
+  }
+  void ToTga(std::uint8_t* dst) const {
+    dst[0] = b;
+    dst[1] = g;
+    dst[2] = r;
+  }
+};
+
+struct PixelRgba8 {
+  std::uint8_t b;
+  std::uint8_t g;
+  std::uint8_t r;
+  std::uint8_t a;
+
+  static constexpr TgaImage::Format kTgaFormat = TgaImage::kRGBA;
+  static constexpr bool kTgaLayout = true;
+  static PixelRgba8 FromColor(const TgaColor& color) {
+    return PixelRgba8{static_cast<std::uint8_t>(color.b),
+                      static_cast<std::uint8_t>(color.g),
+                      static_cast<std::uint8_t>(color.r),
+                      static_cast<std::uint8_t>(color.a)};
+  }
+  void ToTga(std::uint8_t* dst) const {
+    dst[0] = b;
+    dst[1] = g;
+    dst[2] = r;
+    dst[3] = a;
+  }
+};
+
+// 高动态范围的线性颜色，1.0对应8位的255，写出时截断到[0,1]
+struct PixelRgbaF {
+  float r;
+  float g;
+  float b;
+  float a;
+
+  static constexpr TgaImage::Format kTgaFormat = TgaImage::kRGBA;
+  static constexpr bool kTgaLayout = false;
+  static PixelRgbaF FromColor(const TgaColor& color) {
+    const float kScale = 1.f / 255;
+    return PixelRgbaF{static_cast<std::uint8_t>(color.r) * kScale,
+                      static_cast<std::uint8_t>(color.g) * kScale,
+                      static_cast<std::uint8_t>(color.b) * kScale,
+                      static_cast<std::uint8_t>(color.a) * kScale};
+  }
+  void ToTga(std::uint8_t* dst) const {
+    dst[0] = ToUnorm8(b);
+    dst[1] = ToUnorm8(g);
+    dst[2] = ToUnorm8(r);
+    dst[3] = ToUnorm8(a);
+  }
+  static std::uint8_t ToUnorm8(float value) {
+    value = value < 0 ? 0 : (value > 1 ? 1 : value);
+    return static_cast<std::uint8_t>(value * 255 + .5f);
+  }
+};
+
+// 像素格式在编译期确定的帧缓冲。
+// 光栅化阶段直接通过GetRow/At写入像素，不做边界检查，
+// 写一个像素是一次定长的存储，没有TgaImage::SetColor的检查、
+// 乘法与变长memcpy。每行的起始地址对齐到64字节(一个缓存行)，
+// 相邻行不共享缓存行，不同线程写不同tile的行时没有伪共享。
+// 行号与TgaImage相同，第0行是图像最下面一行；只在输出时用
+// ToTgaImage转换为TgaImage。
+template <typename Pixel>
+class Framebuffer {
+ public:
+  static constexpr int kRowAlignment = 64;
+
+  Framebuffer() : Framebuffer(0, 0) {}
+  Framebuffer(int width, int height);
+  ~Framebuffer();
+
+  int GetWidth() const { return width_; }
+  int GetHeight() const { return height_; }
+  // 相邻两行起始地址之间的字节数
+  std::size_t GetStride() const { return stride_; }
+  // 以下访问不检查坐标，调用者保证0 <= x < width、0 <= y < height
+  Pixel* GetRow(int y) {
+    return reinterpret_cast<Pixel*>(reinterpret_cast<std::uint8_t*>(
+                                        lines_.data()) +
+                                    y * stride_);
+  }
+  const Pixel* GetRow(int y) const {
+    return reinterpret_cast<const Pixel*>(
+        reinterpret_cast<const std::uint8_t*>(lines_.data()) + y * stride_);
+  }
+  Pixel& At(int x, int y) { return GetRow(y)[x]; }
+  const Pixel& At(int x, int y) const { return GetRow(y)[x]; }
+
+  // 所有像素置为value，缓冲较大且给出线程池时按行带并行
+  void Fill(const Pixel& value, ThreadPool* pool = nullptr);
+  // 矩形区域置为value，超出缓冲的部分被裁掉
+  void FillRect(int x, int y, int width, int height, const Pixel& value);
+  // 把source中以(source_x, source_y)为左下角、大小为width x height的
+  // 区域复制到本缓冲的(x, y)处，超出任一缓冲的部分被裁掉。
+  // source不能是本缓冲
+  void Blit(const Framebuffer& source, int source_x, int source_y, int width,
+            int height, int x, int y);
+  // 转换为Pixel::kTgaFormat格式的TgaImage，image已分配的内存被复用，
+  // 大小或格式相同时不重新分配
+  void ToTgaImage(TgaImage* image, ThreadPool* pool = nullptr) const;
+
+ private:
+  struct alignas(kRowAlignment) CacheLine {
+    std::uint8_t bytes[kRowAlignment];
+  };
+
+  int width_;
+  int height_;
+  std::size_t stride_;
+  std::vector<CacheLine> lines_;
+};
+
+// 光栅化输出的颜色缓冲，与输出的24位TGA格式一致
+using ColorBuffer = Framebuffer<PixelRgb8>;
+
+#endif  // FRAMEBUFFER_H_
@@ -3,19 +3,36 @@
 
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <initializer_list>
 #include <iostream>
+#include <type_traits>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// 向量与矩阵均为平凡可复制(trivially copyable)的值类型：
+// 复制由编译器生成，可以memcpy、放入寄存器或按值传递而不调用用户代码；
+// 构造与算术运算为constexpr，可用于编译期常量。
+// Vector<float, 4>与Matrix<float, 4, 4>在支持SSE时有16字节对齐的特化，
+// 运算用SSE指令实现，接口与通用模板相同。
 template <typename T, int N>
 class Vector {
  public:
-  Vector();
-  Vector(std::initializer_list<T> list);
-  Vector(const Vector& vector);
-  Vector& operator=(const Vector& rhs);
-  ~Vector() = default;
+  constexpr Vector() : data_() {}
+  // 元素个数与N不符时为零向量
+  constexpr Vector(std::initializer_list<T> list) : data_() {
+    if (static_cast<std::size_t>(N) == list.size()) {
+      auto it = list.begin();
+      for (int i = 0; i < N; ++i, ++it) {
+        data_[i] = *it;
+      }
+    }
+  }
 
-  T& operator[](std::size_t n) { return data_[n]; }
-  const T& operator[](std::size_t n) const { return data_[n]; }
+  constexpr T& operator[](std::size_t n) { return data_[n]; }
+  constexpr const T& operator[](std::size_t n) const { return data_[n]; }
 
   double Norm() const;
 
@@ -28,38 +45,9 @@ using Vector2Int = Vector<int, 2>;
 using Vector3 = Vector<double, 3>;
 using Vector3Int = Vector<int, 3>;
 using Vector4 = Vector<double, 4>;
-
-template <typename T, int N>
-Vector<T, N>::Vector() : data_() {
-  data_.fill(0);
-}
-
-template <typename T, int N>
-Vector<T, N>::Vector(std::initializer_list<T> list) : data_() {
-  if (N == list.size()) {
-    auto it = list.begin();
-    for (int i = 0; i < N; ++i, ++it) {
-      data_[i] = *it;
-    }
-  } else {
-    data_.fill(0);
-  }
-}
-
-template <typename T, int N>
-Vector<T, N>::Vector(const Vector& vector) : data_() {
-  for (int i = 0; i < N; ++i) {
-    data_[i] = vector[i];
-  }
-}
-
-template <typename T, int N>
-Vector<T, N>& Vector<T, N>::operator=(const Vector& rhs) {
-  for (int i = 0; i < N; ++i) {
-    data_[i] = rhs[i];
-  }
-  return *this;
-}
+using Vector2f = Vector<float, 2>;
+using Vector3f = Vector<float, 3>;
+using Vector4f = Vector<float, 4>;
 
 template <typename T, int N>
 double Vector<T, N>::Norm() const {
@@ -72,7 +60,7 @@ double Vector<T, N>::Norm() const {
 
 // arithmetic operator overloading
 template <typename T, int N>
-Vector<T, N> operator+(const Vector<T, N>& lhs, const T& rhs) {
+constexpr Vector<T, N> operator+(const Vector<T, N>& lhs, const T& rhs) {
   Vector<T, N> res = lhs;
   for (int i = 0; i < N; ++i) {
     res[i] += rhs;
@@ -80,7 +68,7 @@ Vector<T, N> operator+(const Vector<T, N>& lhs, const T& rhs) {
   return res;
 }
 template <typename T, int N>
-Vector<T, N> operator-(const Vector<T, N>& lhs, const T& rhs) {
+constexpr Vector<T, N> operator-(const Vector<T, N>& lhs, const T& rhs) {
   Vector<T, N> res = lhs;
   for (int i = 0; i < N; ++i) {
     res[i] -= rhs;
@@ -88,7 +76,7 @@ Vector<T, N> operator-(const Vector<T, N>& lhs, const T& rhs) {
   return res;
 }
 template <typename T, int N>
-Vector<T, N> operator*(const Vector<T, N>& lhs, const T& rhs) {
+constexpr Vector<T, N> operator*(const Vector<T, N>& lhs, const T& rhs) {
   Vector<T, N> res = lhs;
   for (int i = 0; i < N; ++i) {
     res[i] *= rhs;
@@ -96,15 +84,12 @@ Vector<T, N> operator*(const Vector<T, N>& lhs, const T& rhs) {
   return res;
 }
 template <typename T, int N>
-Vector<T, N> operator*(const T& lhs, const Vector<T, N>& rhs) {
+constexpr Vector<T, N> operator*(const T& lhs, const Vector<T, N>& rhs) {
   return rhs * lhs;
 }
+// 除数为0时按IEEE 754得到inf/nan(整数向量为未定义行为)，由调用方保证
 template <typename T, int N>
-Vector<T, N> operator/(const Vector<T, N>& lhs, const T& rhs) {
-  if (0 == rhs) {
-    std::cerr << "Vector can't be divided by 0.\n";
-    exit(1);
-  }
+constexpr Vector<T, N> operator/(const Vector<T, N>& lhs, const T& rhs) {
   Vector<T, N> res = lhs;
   for (int i = 0; i < N; ++i) {
     res[i] /= rhs;
@@ -112,7 +97,8 @@ Vector<T, N> operator/(const Vector<T, N>& lhs, const T& rhs) {
   return res;
 }
 template <typename T, int N>
-Vector<T, N> operator+(const Vector<T, N>& lhs, const Vector<T, N>& rhs) {
+constexpr Vector<T, N> operator+(const Vector<T, N>& lhs,
+                                 const Vector<T, N>& rhs) {
   Vector<T, N> res = lhs;
   for (int i = 0; i < N; ++i) {
     res[i] += rhs[i];
@@ -120,7 +106,8 @@ Vector<T, N> operator+(const Vector<T, N>& lhs, const Vector<T, N>& rhs) {
   return res;
 }
 template <typename T, int N>
-Vector<T, N> operator-(const Vector<T, N>& lhs, const Vector<T, N>& rhs) {
+constexpr Vector<T, N> operator-(const Vector<T, N>& lhs,
+                                 const Vector<T, N>& rhs) {
   Vector<T, N> res = lhs;
   for (int i = 0; i < N; ++i) {
     res[i] -= rhs[i];
@@ -129,9 +116,10 @@ Vector<T, N> operator-(const Vector<T, N>& lhs, const Vector<T, N>& rhs) {
 }
 
 namespace vector_m {
-template <int N>
-double Dot(const Vector<double, N>& v1, const Vector<double, N>& v2) {
-  double sum = 0;
+// 模板参数保持N在前，原有的Dot<N>(...)写法仍然有效
+template <int N, typename T = double>
+constexpr T Dot(const Vector<T, N>& v1, const Vector<T, N>& v2) {
+  T sum = 0;
   for (int i = 0; i < N; ++i) {
     sum += v1[i] * v2[i];
   }
@@ -156,16 +144,16 @@ Vector4 HomogeneousCoords(const Vector3& vector3);
 }  // namespace vector_m
 
 // matrix
+// 行主序存放
 template <typename T, int ROW, int COL>
 class Matrix {
  public:
-  Matrix();
-  Matrix(const Matrix& m);
-  Matrix& operator=(const Matrix& rhs);
-  ~Matrix() = default;
+  constexpr Matrix() : data_() {}
 
-  T& operator()(int i, int j) { return data_[i * COL + j]; }
-  const T& operator()(int i, int j) const { return data_[i * COL + j]; }
+  constexpr T& operator()(int i, int j) { return data_[i * COL + j]; }
+  constexpr const T& operator()(int i, int j) const {
+    return data_[i * COL + j];
+  }
 
  private:
   std::array<T, ROW * COL> data_;
@@ -173,36 +161,14 @@ class Matrix {
 
 using SMatrix3 = Matrix<double, 3, 3>;
 using SMatrix4 = Matrix<double, 4, 4>;
-
-template <typename T, int ROW, int COL>
-Matrix<T, ROW, COL>::Matrix() : data_() {
-  data_.fill(0);
-}
-
-template <typename T, int ROW, int COL>
-Matrix<T, ROW, COL>::Matrix(const Matrix& m) : data_() {
-  for (int i = 0; i < ROW; ++i) {
-    for (int j = 0; j < COL; ++j) {
-      data_[i * COL + j] = m(i, j);
-    }
-  }
-}
-
-template <typename T, int ROW, int COL>
-Matrix<T, ROW, COL>& Matrix<T, ROW, COL>::operator=(const Matrix& rhs) {
-  for (int i = 0; i < ROW; ++i) {
-    for (int j = 0; j < COL; ++j) {
-      data_[i * COL + j] = rhs(i, j);
-    }
-  }
-  return *this;
-}
+using SMatrix3f = Matrix<float, 3, 3>;
+using SMatrix4f = Matrix<float, 4, 4>;
 
 // operator
 // m[ROW][COM]*m[COM][COL]
 template <typename T, int ROW, int COM, int COL>
-Matrix<T, ROW, COL> operator*(const Matrix<T, ROW, COM>& lhs,
-                              const Matrix<T, COM, COL>& rhs) {
+constexpr Matrix<T, ROW, COL> operator*(const Matrix<T, ROW, COM>& lhs,
+                                        const Matrix<T, COM, COL>& rhs) {
   Matrix<T, ROW, COL> res;
   for (int i = 0; i < ROW; ++i) {
     for (int j = 0; j < COL; ++j) {
@@ -219,8 +185,8 @@ Matrix<T, ROW, COL> operator*(const Matrix<T, ROW, COM>& lhs,
 // matrix*vector->vector
 // 返回一定是列向量
 template <typename T, int ROW, int COM>
-Vector<T, ROW> operator*(const Matrix<T, ROW, COM>& lhs,
-                         const Vector<T, COM>& rhs) {
+constexpr Vector<T, ROW> operator*(const Matrix<T, ROW, COM>& lhs,
+                                   const Vector<T, COM>& rhs) {
   Vector<T, ROW> res;
   for (int i = 0; i < ROW; ++i) {
     T value = 0;
@@ -234,7 +200,7 @@ Vector<T, ROW> operator*(const Matrix<T, ROW, COM>& lhs,
 
 namespace matrix_m {
 template <typename T, int ROW, int COL>
-Matrix<T, COL, ROW> Transpose(const Matrix<T, ROW, COL>& m) {
+constexpr Matrix<T, COL, ROW> Transpose(const Matrix<T, ROW, COL>& m) {
   Matrix<T, COL, ROW> t;
   for (int i = 0; i < ROW; ++i) {
     for (int j = 0; j < COL; ++j) {
@@ -248,4 +214,127 @@ SMatrix3 IMatrix3();
 SMatrix4 IMatrix4();
 }  // namespace matrix_m
 
+#ifdef __SSE__
+// Vector<float, 4>的SSE特化，4个分量正好占一个__m128
+template <>
+class alignas(16) Vector<float, 4> {
+ public:
+  constexpr Vector() : data_() {}
+  // 元素个数与4不符时为零向量
+  constexpr Vector(std::initializer_list<float> list) : data_() {
+    if (4 == list.size()) {
+      auto it = list.begin();
+      for (int i = 0; i < 4; ++i, ++it) {
+        data_[i] = *it;
+      }
+    }
+  }
+  explicit Vector(__m128 value) { _mm_store_ps(data_.data(), value); }
+
+  constexpr float& operator[](std::size_t n) { return data_[n]; }
+  constexpr const float& operator[](std::size_t n) const { return data_[n]; }
+  __m128 Load() const { return _mm_load_ps(data_.data()); }
+
+  double Norm() const;
+
+ private:
+  std::array<float, 4> data_;
+};
+
+inline Vector4f operator+(const Vector4f& lhs, float rhs) {
+  return Vector4f(_mm_add_ps(lhs.Load(), _mm_set1_ps(rhs)));
+}
+inline Vector4f operator-(const Vector4f& lhs, float rhs) {
+  return Vector4f(_mm_sub_ps(lhs.Load(), _mm_set1_ps(rhs)));
+}
+inline Vector4f operator*(const Vector4f& lhs, float rhs) {
+  return Vector4f(_mm_mul_ps(lhs.Load(), _mm_set1_ps(rhs)));
+}
+inline Vector4f operator*(float lhs, const Vector4f& rhs) { return rhs * lhs; }
+inline Vector4f operator/(const Vector4f& lhs, float rhs) {
+  return Vector4f(_mm_div_ps(lhs.Load(), _mm_set1_ps(rhs)));
+}
+inline Vector4f operator+(const Vector4f& lhs, const Vector4f& rhs) {
+  return Vector4f(_mm_add_ps(lhs.Load(), rhs.Load()));
+}
+inline Vector4f operator-(const Vector4f& lhs, const Vector4f& rhs) {
+  return Vector4f(_mm_sub_ps(lhs.Load(), rhs.Load()));
+}
+
+namespace vector_m {
+inline float Dot(const Vector4f& v1, const Vector4f& v2) {
+  __m128 p = _mm_mul_ps(v1.Load(), v2.Load());
+  // (p0+p2, p1+p3, ...)，再把前两个分量相加
+  __m128 s = _mm_add_ps(p, _mm_movehl_ps(p, p));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+  return _mm_cvtss_f32(s);
+}
+
+// 前三个分量的叉积，w分量为0
+inline Vector4f Cross(const Vector4f& v1, const Vector4f& v2) {
+  __m128 a = v1.Load();
+  __m128 b = v2.Load();
+  __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+  __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+  __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+  return Vector4f(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+}
+}  // namespace vector_m
+
+inline double Vector<float, 4>::Norm() const {
+  return std::sqrt(static_cast<double>(vector_m::Dot(*this, *this)));
+}
+
+// Matrix<float, 4, 4>的SSE特化，每行占一个__m128
+template <>
+class alignas(16) Matrix<float, 4, 4> {
+ public:
+  constexpr Matrix() : data_() {}
+
+  constexpr float& operator()(int i, int j) { return data_[i * 4 + j]; }
+  constexpr const float& operator()(int i, int j) const {
+    return data_[i * 4 + j];
+  }
+  __m128 LoadRow(int i) const { return _mm_load_ps(&data_[i * 4]); }
+  void StoreRow(int i, __m128 row) { _mm_store_ps(&data_[i * 4], row); }
+
+ private:
+  std::array<float, 16> data_;
+};
+
+// 结果的第i行为rhs各行以lhs第i行元素为权重的线性组合
+inline SMatrix4f operator*(const SMatrix4f& lhs, const SMatrix4f& rhs) {
+  __m128 r0 = rhs.LoadRow(0);
+  __m128 r1 = rhs.LoadRow(1);
+  __m128 r2 = rhs.LoadRow(2);
+  __m128 r3 = rhs.LoadRow(3);
+  SMatrix4f res;
+  for (int i = 0; i < 4; ++i) {
+    __m128 row = _mm_mul_ps(_mm_set1_ps(lhs(i, 0)), r0);
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(lhs(i, 1)), r1));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(lhs(i, 2)), r2));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(lhs(i, 3)), r3));
+    res.StoreRow(i, row);
+  }
+  return res;
+}
+
+// 各行与向量逐分量相乘后转置，四个乘积向量相加即得到四个点积
+inline Vector4f operator*(const SMatrix4f& lhs, const Vector4f& rhs) {
+  __m128 v = rhs.Load();
+  __m128 p0 = _mm_mul_ps(lhs.LoadRow(0), v);
+  __m128 p1 = _mm_mul_ps(lhs.LoadRow(1), v);
+  __m128 p2 = _mm_mul_ps(lhs.LoadRow(2), v);
+  __m128 p3 = _mm_mul_ps(lhs.LoadRow(3), v);
+  _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+  return Vector4f(_mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+}
+#endif  // __SSE__
+
+static_assert(std::is_trivially_copyable<Vector3>::value &&
+                  std::is_trivially_copyable<Vector4f>::value &&
+                  std::is_trivially_copyable<SMatrix4>::value &&
+                  std::is_trivially_copyable<SMatrix4f>::value,
+              "geometry types must stay trivially copyable");
+
 #endif  // GEOMETRY_H_
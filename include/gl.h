@@ -1,8 +1,22 @@
 #ifndef GL_H_
 #define GL_H_
 
+#include <array>
+
 #include "include/geometry.h"
 
+// 经过顶点处理后送入光栅化阶段的三角形
+// vertices 屏幕空间坐标(已完成透视除法和视口变换)
+// texture_coordinates 三个顶点对应的纹理坐标
+// barycentric_dx/dy 重心坐标对屏幕x、y的偏导数，屏幕空间线性插值下
+//   在整个三角形上为常数，由光栅化器在三角形建立阶段填写
+struct Triangle {
+  std::array<Vector4, 3> vertices;
+  std::array<Vector2, 3> texture_coordinates;
+  Vector3 barycentric_dx;
+  Vector3 barycentric_dy;
+};
+
 // 设置相机相关参数，返回将世界坐标转换为相机坐标的矩阵mCamera
 SMatrix4 CameraTransM(const Vector3& camera_pos, const Vector3& gaze_direction,
                       const Vector3& viewup);
@@ -0,0 +1,78 @@
+#ifndef IMAGE_ENCODER_H_
+#define IMAGE_ENCODER_H_
+
+#include <string>
+
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+// 把TgaImage写成某种图像文件格式的编码器。
+// 编码器本身没有可变状态，多个写线程可以同时使用同一个编码器。
+// TgaImage的第0行是最下面一行，非TGA格式在编码时按自上而下的顺序输出；
+// 尚未应用的翻转(见TgaImage::ReadTgaFile)在转换各行时一并应用。
+class ImageEncoder {
+ public:
+  virtual ~ImageEncoder() {}
+  // 不含点的文件扩展名
+  virtual std::string GetExtension() const = 0;
+  // @param filename 为"-"时写到标准输出，便于用管道交给其他程序
+  // @param pool 为nullptr时在调用线程中编码
+  virtual bool Write(const TgaImage& image, const std::string& filename,
+                     ThreadPool* pool) const = 0;
+};
+
+// TgaImage::WriteTgaFile的包装
+class TgaEncoder final : public ImageEncoder {
+ public:
+  explicit TgaEncoder(bool rle = false) : rle_(rle) {}
+  std::string GetExtension() const override;
+  bool Write(const TgaImage& image, const std::string& filename,
+             ThreadPool* pool) const override;
+
+ private:
+  bool rle_;
+};
+
+// 没有文件头的RGBA像素，每像素4字节，行自上而下，
+// 可以直接作为rawvideo(rgba)的一帧。灰度复制到RGB，无alpha时为255
+class RawEncoder final : public ImageEncoder {
+ public:
+  std::string GetExtension() const override;
+  bool Write(const TgaImage& image, const std::string& filename,
+             ThreadPool* pool) const override;
+};
+
+// 二进制PPM(P6)，灰度图写成PGM(P5)，alpha通道被丢弃
+class PpmEncoder final : public ImageEncoder {
+ public:
+  std::string GetExtension() const override;
+  bool Write(const TgaImage& image, const std::string& filename,
+             ThreadPool* pool) const override;
+};
+
+// PNG，使用自带的deflate实现，不依赖zlib。
+// 图像按行带划分，各行带独立做行滤波与压缩，每个行带输出为一个IDAT块，
+// 行带的deflate数据以字节对齐的空存储块结束，依次拼接即为完整的
+// zlib数据流；adler32由各行带的校验和合并得到。行带之间不共享LZ77窗口，
+// 行带数取决于线程数，压缩结果与线程数有关。
+class PngEncoder final : public ImageEncoder {
+ public:
+  enum Level {
+    // 不压缩，只有存储块，行不滤波
+    kStored = 0,
+    // 每个位置只查一个候选匹配的贪心LZ77，固定哈夫曼编码
+    kFast = 1,
+    // 沿哈希链查找多个候选匹配，较慢但输出更小
+    kSmall = 2,
+  };
+
+  explicit PngEncoder(Level level = kFast) : level_(level) {}
+  std::string GetExtension() const override;
+  bool Write(const TgaImage& image, const std::string& filename,
+             ThreadPool* pool) const override;
+
+ private:
+  Level level_;
+};
+
+#endif  // IMAGE_ENCODER_H_
@@ -0,0 +1,47 @@
+#ifndef INDEXED_MESH_H_
+#define INDEXED_MESH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "include/model.h"
+
+// 交错存放的顶点，一个顶点恰好64字节，与缓存行大小相同
+struct MeshVertex {
+  double position[3];
+  double texture_coordinates[2];
+  double normal[3];
+};
+
+// 带索引的网格。
+// ObjModel中面的每个角分别引用顶点、纹理坐标、法线三个数组，
+// 这里把不同的(v, vt, vn)组合去重为一个交错的顶点缓冲，面只保留一个
+// 32位索引缓冲，每个角的属性只需一次访问。
+// OptimizeVertexCache按Forsyth的线性时间算法重排三角形，使相邻三角形
+// 尽量共享最近用过的顶点，并按首次使用的顺序重排顶点，
+// 渲染时对顶点数据的访问更集中。
+class IndexedMesh {
+ public:
+  explicit IndexedMesh(const ObjModel& model);
+  ~IndexedMesh();
+
+  int GetVertexNum() const { return static_cast<int>(vertices_.size()); }
+  int GetTriangleNum() const { return static_cast<int>(indices_.size() / 3); }
+  const MeshVertex& GetVertex(int index) const { return vertices_[index]; }
+  // 第i个三角形的顶点索引为indices[3*i], indices[3*i+1], indices[3*i+2]
+  const std::vector<std::uint32_t>& GetIndices() const { return indices_; }
+
+  void OptimizeVertexCache();
+  // 以FIFO顶点缓存模拟按当前顺序绘制，平均每个三角形未命中的顶点数(ACMR)
+  // @param cache_size 模拟的顶点缓存大小
+  double ComputeAcmr(int cache_size) const;
+
+ private:
+  // Forsyth算法中模拟的LRU缓存大小
+  static constexpr int kCacheSize = 32;
+
+  std::vector<MeshVertex> vertices_;
+  std::vector<std::uint32_t> indices_;
+};
+
+#endif  // INDEXED_MESH_H_
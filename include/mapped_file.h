@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// 以只读方式整体映射到内存的文件。
+// 映射后的数据直接由页缓存提供，读取时不经过用户态缓冲区拷贝，
+// 未访问的页不会被读入。对象析构或Close时解除映射。
+class MappedFile {
+ public:
+  MappedFile();
+  MappedFile(const MappedFile& file) = delete;
+  MappedFile& operator=(const MappedFile& rhs) = delete;
+  MappedFile(MappedFile&& file) noexcept;
+  MappedFile& operator=(MappedFile&& rhs) noexcept;
+  ~MappedFile();
+
+  // 映射整个文件，已映射的文件先被关闭
+  // @return 文件不存在、为空或映射失败时返回false
+  bool Open(const std::string& filename);
+  void Close();
+  bool IsOpen() const { return nullptr != data_; }
+  const unsigned char* GetData() const { return data_; }
+  std::size_t GetSize() const { return size_; }
+  // 把[offset, offset + length)所在的页从进程的驻留内存中释放，
+  // 再次访问时从页缓存或文件重新读入。流式读取时用于限制常驻内存
+  void DropPages(std::size_t offset, std::size_t length) const;
+
+ private:
+  const unsigned char* data_;
+  std::size_t size_;
+};
+
+#endif  // MAPPED_FILE_H_
@@ -0,0 +1,88 @@
+#ifndef MESH_STREAM_H_
+#define MESH_STREAM_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/mapped_file.h"
+#include "include/model.h"
+
+// 按固定大小的分段流式读取网格缓存中的面，用于渲染无法整体放入内存的模型。
+// 生产者线程依次把每个分段的面展开为逐角的顶点坐标与纹理坐标，
+// 读取映射文件引起的缺页(即磁盘I/O)发生在生产者线程，与消费者的渲染重叠。
+// 面下标按顺序读取，处理完的分段的下标页随即被释放；顶点与纹理坐标
+// 随机访问，记录读过的区域，驻留量超过预算时才整体释放，
+// 常驻内存只取决于分段大小、分段数与预算，与模型大小无关。
+// 分段中有越界的面下标时，从该分段起停止读取。
+// 消费者用Acquire按文件顺序取得分段，用完后Release归还给生产者复用。
+class MeshStream {
+ public:
+  // 同时存在的分段数：生产者填充、就绪等待、消费者处理各一个
+  static constexpr int kChunkNum = 3;
+  // 分段中每个面占用的字节数：3个角，每角3个坐标和2个纹理坐标
+  static constexpr std::size_t kBytesPerFace = 3 * 5 * sizeof(double);
+
+  // 一个分段，按角存放(第i个面的第k个角下标为3*i+k)
+  struct Chunk {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+    std::vector<double> u;
+    std::vector<double> v;
+    int face_num = 0;
+  };
+
+  // @param filename 网格缓存文件，见ObjModel::WriteMeshCache
+  // @param chunk_face_num 每个分段的面数
+  // @param vertex_budget 顶点与纹理坐标允许驻留的字节数
+  MeshStream(const std::string& filename, int chunk_face_num,
+             std::size_t vertex_budget);
+  MeshStream(const MeshStream& stream) = delete;
+  MeshStream& operator=(const MeshStream& rhs) = delete;
+  ~MeshStream();
+
+  // 文件打开失败或不是有效的网格缓存时返回false
+  bool IsOpen() const;
+  std::size_t GetFaceNum() const;
+  // 每个分段最多的面数，不超过模型的面数
+  int GetChunkFaceNum() const;
+  // 阻塞直到下一个分段就绪
+  // @return 所有面都已读取时返回nullptr
+  const Chunk* Acquire();
+  void Release(const Chunk* chunk);
+
+ private:
+  void ProducerLoop();
+  // 估计驻留量时的粒度，与内核缺页时一并映射相邻页的范围(64KiB)相当
+  static constexpr std::size_t kResidencyBlock = 1 << 16;
+
+  // 展开[begin, begin + chunk->face_num)的面
+  // @return 有越界的面下标时返回false
+  bool Fill(std::size_t begin, Chunk* chunk);
+  // 记录[offset, offset + length)已被读取
+  void Touch(std::size_t offset, std::size_t length);
+
+  MappedFile file_;
+  MeshCacheHeader header_;
+  int chunk_face_num_;
+  std::size_t vertex_budget_;
+  // 自上次释放以来读过的顶点与纹理坐标区域，按kResidencyBlock记录
+  std::vector<bool> touched_blocks_;
+  std::size_t touched_bytes_;
+  Chunk chunks_[kChunkNum];
+  std::deque<Chunk*> free_chunks_;
+  // 按文件顺序排列的已填充分段
+  std::deque<Chunk*> ready_chunks_;
+  bool done_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread producer_;
+};
+
+#endif  // MESH_STREAM_H_
@@ -1,45 +1,113 @@
 #ifndef MODEL_H_
 #define MODEL_H_
 
-#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "include/geometry.h"
+#include "include/mapped_file.h"
+#include "include/thread_pool.h"
 
 // 读取Wavefront.obj文件并存储其中数据.
 // vertices_ 几何顶点坐标;
 // normals_ 顶点法线，单位向量;
 // faces_ 三角面元 存储顶点index;
 // faces_normals_ 三角面元每个顶点法线的index;
+//
+// 除文本格式外还支持二进制网格缓存：首次解析.obj后由WriteMeshCache写出，
+// 之后以同一构造函数打开缓存文件时直接mmap，各数组就地使用，
+// 既不解析也不拷贝。缓存文件格式见MeshCacheHeader。
+//
+// 文本格式整体映射到内存后按换行切分成若干段，在线程池上用from_chars
+// 并行解析，再按原顺序合并。面支持 v、v/vt、v//vn、v/vt/vn 以及负数
+// (相对)下标，多于三个顶点的多边形按扇形拆分为三角形。
+// 面中省略的纹理坐标/法线下标为-1，对应的GetTexture/GetNormal返回零向量。
+// 格式错误或顶点下标越界的面被跳过并报告，其余部分照常加载；
+// 面的最后一个顶点之后可以有'#'开头的注释。
 class ObjModel {
  public:
-  explicit ObjModel(const std::string& filename);
+  // 根据文件头判断是网格缓存还是.obj文本
+  // @param pool 解析文本使用的线程池，为nullptr时在当前线程解析
+  explicit ObjModel(const std::string& filename, ThreadPool* pool = nullptr);
+  ObjModel(const ObjModel& model) = delete;
+  ObjModel& operator=(const ObjModel& rhs) = delete;
   ~ObjModel();
   Vector3 GetVertex(int index) const;
   Vector2 GetTexture(int index) const;
   Vector3 GetNormal(int index) const;
+  std::size_t GetVertexNum() const;
   std::size_t GetFaceNum() const;
   Vector3Int GetFaceVertices(int index) const;
   Vector3Int GetFaceVertexTextures(int index) const;
   Vector3Int GetFaceVertexNormals(int index) const;
+  // 数据是否来自映射的网格缓存
+  bool IsMapped() const;
+  // @return 写入失败时返回false
+  bool WriteMeshCache(const std::string& filename) const;
 
  private:
-  std::vector<Vector3> vertices_;
-  std::vector<Vector2> textures_;
-  std::vector<Vector3> normals_;
-  std::vector<Vector3Int> faces_vertices_;
-  std::vector<Vector3Int> faces_vertex_textures_;
-  std::vector<Vector3Int> faces_vertex_normals_;
+  // 按文本格式解析，数据存放在下面的vector中
+  void ParseObj(const MappedFile& file, ThreadPool* pool);
+  // 文件是有效的网格缓存时接管其映射
+  // @return 文件不是网格缓存时返回false；格式损坏或面下标越界时
+  //   返回true，模型为空
+  bool MapMeshCache(MappedFile* file, const std::string& filename);
+
+  // 各数组的只读视图，指向下面的vector或映射的缓存文件。
+  // 每个顶点/法线3个double，每个纹理坐标2个double，每个面3个下标
+  const double* vertices_;
+  const double* textures_;
+  const double* normals_;
+  const int* faces_vertices_;
+  const int* faces_vertex_textures_;
+  const int* faces_vertex_normals_;
+  std::size_t vertex_num_;
+  std::size_t texture_num_;
+  std::size_t normal_num_;
+  std::size_t face_num_;
+
+  std::vector<double> vertex_data_;
+  std::vector<double> texture_data_;
+  std::vector<double> normal_data_;
+  std::vector<int> face_vertex_data_;
+  std::vector<int> face_texture_data_;
+  std::vector<int> face_normal_data_;
+  MappedFile cache_;
+};
+
+// 网格缓存文件头，位于文件开头。
+// 其后依次为顶点、纹理坐标、法线(double)以及面的顶点、纹理坐标、
+// 法线下标(int32)共6个数组，offsets为各数组在文件中的起始偏移，
+// 对齐到64字节，映射后可以直接作为对应类型的数组访问。
+// 数据按本机字节序存放，byte_order不匹配的缓存视为无效。
+struct MeshCacheHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t vertex_num;
+  std::uint64_t texture_num;
+  std::uint64_t normal_num;
+  std::uint64_t face_num;
+  std::uint64_t offsets[6];
+  std::uint64_t file_size;
 };
 
-// Wavefront.obj的文件格式中，面元数据行格式为f v1/vt1/vn1 v2/vt2/vn2
-// v3/vt3/vn3。
-// 该函数负责将形如v1/vt/vn1的字符串转化为{v1,vt,vn1},存储到参数数组中。
-// @param vertex_data 形如v1/vt/vn1的字符串。
-// @param array 存储{v1,vt,vn1}，容量为3的数组
-// 使用数组减少堆内存碎片。
-void SplitObjFaceVertexStr(const std::string& vertex_data_str,
-                           std::array<std::string, 3>& array);
+// 文件开头是否为网格缓存的标识
+bool IsMeshCache(const MappedFile& file);
+// 读取并检查网格缓存的文件头与各数组范围
+// @return 不是网格缓存、版本不匹配或文件损坏时返回false
+bool ReadMeshCacheHeader(const MappedFile& file, const std::string& filename,
+                         MeshCacheHeader* header);
+// 检查缓存中第[begin, begin + count)个面的下标：顶点下标在
+// [0, vertex_num)中，纹理坐标与法线下标为-1或在对应的数量之内。
+// header须已通过ReadMeshCacheHeader的检查
+// @return 有越界的下标时返回false
+bool CheckMeshCacheFaces(const MappedFile& file, const MeshCacheHeader& header,
+                         std::size_t begin, std::size_t count);
+// 网格缓存存在且修改时间不早于.obj文件时返回true
+bool IsMeshCacheFresh(const std::string& obj_filename,
+                      const std::string& cache_filename);
 
 #endif  // MODEL_H_
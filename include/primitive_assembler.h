@@ -0,0 +1,72 @@
+#ifndef PRIMITIVE_ASSEMBLER_H_
+#define PRIMITIVE_ASSEMBLER_H_
+
+#include <array>
+
+#include "include/geometry.h"
+#include "include/gl.h"
+#include "include/rasterizer.h"
+
+// 图元装配，位于顶点处理与光栅化之间。
+// 输入为裁剪空间(投影变换后、透视除法前)的三角形，依次进行
+// 背面剔除、视锥体平凡拒绝、对视锥体六个平面的Sutherland-Hodgman裁剪，
+// 最后做透视除法和视口变换，把得到的屏幕空间三角形提交给光栅化器。
+//
+// ProjectionM中m(3,2)=1，相机前方的点 w=z<0。齐次坐标整体取反
+// 不改变其表示的点，因此这里先取反，使可见区域成为标准形式
+// -w<=x,y,z<=w (w>0)。
+class PrimitiveAssembler {
+ public:
+  enum CullMode {
+    kCullNone = 0,
+    kCullBack = 1,
+    kCullFront = 2,
+  };
+  // 正面三角形在屏幕上(y轴向上)的顶点绕序
+  enum Winding {
+    kCounterClockwise = 0,
+    kClockwise = 1,
+  };
+
+  // 自上次ResetStats以来的统计
+  struct Stats {
+    long long triangles_in = 0;
+    long long backface_culled = 0;
+    // 三个顶点都在同一裁剪平面外侧而被整体丢弃
+    long long frustum_culled = 0;
+    // 跨越裁剪平面而需要裁剪的三角形
+    long long clipped = 0;
+    // 提交给光栅化器的三角形(裁剪后的多边形按扇形拆分)
+    long long triangles_out = 0;
+  };
+
+  PrimitiveAssembler(double screen_width, double screen_height);
+  ~PrimitiveAssembler();
+
+  void SetCullMode(CullMode mode);
+  void SetFrontFace(Winding winding);
+  // @param triangle 顶点为裁剪空间坐标
+  void Assemble(const Triangle& triangle, Rasterizer* rasterizer);
+  Stats GetStats() const;
+  void ResetStats();
+
+ private:
+  // 三角形被6个平面依次裁剪，最多产生3+6个顶点
+  static constexpr int kMaxClipVertices = 9;
+
+  struct ClipVertex {
+    Vector4 position;
+    Vector2 texture_coordinates;
+  };
+
+  // 裁剪后的凸多边形按扇形拆分、投影到屏幕并提交
+  void Emit(const ClipVertex* polygon, int vertex_num,
+            Rasterizer* rasterizer);
+
+  SMatrix4 m_vp_;
+  CullMode cull_mode_ = kCullBack;
+  Winding front_face_ = kCounterClockwise;
+  Stats stats_;
+};
+
+#endif  // PRIMITIVE_ASSEMBLER_H_
@@ -0,0 +1,149 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "include/primitive_assembler.h"
+#include "include/rasterizer.h"
+
+// 定义RENDERER_NO_PROFILE编译时去掉所有计时与光栅化器中的像素计数，
+// ScopedTimer为空类，Profiler的记录函数不会被调用
+#ifdef RENDERER_NO_PROFILE
+constexpr bool kProfilerEnabled = false;
+#else
+constexpr bool kProfilerEnabled = true;
+#endif
+
+// 渲染管线各阶段的耗时与计数统计。
+// 计时由ScopedTimer在作用域结束时提交，每次提交加锁一次，
+// 计时粒度为整个阶段而不是单个三角形或像素，锁的开销可以忽略。
+// 像素级的计数在光栅化器的各tile中分别累加(Rasterizer::Stats)，
+// Flush时合并，帧结束后由AddRenderStats一次性记入。
+// 片元着色在光栅化的span循环中内联执行，没有单独的计时，
+// 其耗时包含在kRasterization中，调用次数即kShaderInvocations。
+class Profiler {
+ public:
+  enum Stage {
+    kModelLoad = 0,
+    kTextureLoad = 1,
+    kVertexProcessing = 2,
+    // 裁剪、背面剔除与光栅化器的三角形建立
+    kPrimitiveAssembly = 3,
+    // Rasterizer::Flush，含深度测试与片元着色
+    kRasterization = 4,
+    // 画布转换为TgaImage与编码写文件
+    kImageWrite = 5,
+    kStageNum = 6,
+  };
+
+  enum Counter {
+    kTrianglesSubmitted = 0,
+    kTrianglesBackfaceCulled = 1,
+    kTrianglesFrustumCulled = 2,
+    // 被层次深度测试整体剔除
+    kTrianglesOcclusionCulled = 3,
+    kTrianglesRasterized = 4,
+    kPixelsTested = 5,
+    kDepthPassed = 6,
+    kDepthFailed = 7,
+    kShaderInvocations = 8,
+    kCounterNum = 9,
+  };
+
+  // 不属于任何一帧的阶段(加载模型、纹理)使用的帧号
+  static constexpr int kSetupFrame = -1;
+
+  using Clock = std::chrono::steady_clock;
+
+  Profiler();
+  Profiler(const Profiler& profiler) = delete;
+  Profiler& operator=(const Profiler& rhs) = delete;
+  ~Profiler();
+
+  // 进程内共享的实例
+  static Profiler& Global();
+
+  // 运行时开关，默认关闭，关闭时计时器不读时钟
+  void SetEnabled(bool enabled);
+  bool IsEnabled() const {
+    return kProfilerEnabled && enabled_.load(std::memory_order_relaxed);
+  }
+
+  // 记录frame帧的stage阶段在[begin, end)中执行了一次，
+  // 同一帧同一阶段的多次记录累加，可以在任意线程调用
+  void Record(Stage stage, int frame, Clock::time_point begin,
+              Clock::time_point end);
+  void AddCounter(Counter counter, int frame, long long value);
+  // 把一帧的图元装配与光栅化统计记入各计数
+  void AddRenderStats(int frame, const PrimitiveAssembler::Stats& assembler,
+                      const Rasterizer::Stats& rasterizer);
+  // 清除所有记录
+  void Reset();
+
+  // 每帧一行JSON对象，按帧号排列：
+  // {"frame":0,"stages_ms":{"vertex_processing":1.2,...},
+  //  "counters":{"triangles_submitted":2492,...}}
+  bool WriteJson(const std::string& filename) const;
+  // Chrome的trace event格式，可以在chrome://tracing或Perfetto中查看，
+  // 每次Record是一个完整事件，线程号为记录线程的序号
+  bool WriteChromeTrace(const std::string& filename) const;
+
+ private:
+  struct FrameRecord {
+    std::array<double, kStageNum> seconds{};
+    std::array<long long, kCounterNum> counters{};
+  };
+  struct Event {
+    Stage stage;
+    int frame;
+    int thread;
+    Clock::time_point begin;
+    Clock::time_point end;
+  };
+
+  std::atomic<bool> enabled_{false};
+  mutable std::mutex mutex_;
+  std::map<int, FrameRecord> frames_;
+  std::vector<Event> events_;
+  // 所有事件的时间戳都相对于该时刻
+  Clock::time_point origin_;
+};
+
+#ifndef RENDERER_NO_PROFILE
+// 作用域计时器，构造时开始，析构时把耗时记入Profiler::Global()
+class ScopedTimer {
+ public:
+  ScopedTimer(Profiler::Stage stage, int frame)
+      : stage_(stage), frame_(frame), enabled_(Profiler::Global().IsEnabled()) {
+    if (enabled_) begin_ = Profiler::Clock::now();
+  }
+  ScopedTimer(const ScopedTimer& timer) = delete;
+  ScopedTimer& operator=(const ScopedTimer& rhs) = delete;
+  ~ScopedTimer() {
+    if (enabled_) {
+      Profiler::Global().Record(stage_, frame_, begin_, Profiler::Clock::now());
+    }
+  }
+
+ private:
+  Profiler::Stage stage_;
+  int frame_;
+  bool enabled_;
+  Profiler::Clock::time_point begin_;
+};
+#else
+class ScopedTimer {
+ public:
+  ScopedTimer(Profiler::Stage, int) {}
+  ScopedTimer(const ScopedTimer& timer) = delete;
+  ScopedTimer& operator=(const ScopedTimer& rhs) = delete;
+};
+#endif
+
+#endif  // PROFILER_H_
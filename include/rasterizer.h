@@ -0,0 +1,165 @@
+#ifndef RASTERIZER_H_
+#define RASTERIZER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "include/depth_buffer.h"
+#include "include/geometry.h"
+#include "include/gl.h"
+#include "include/shader.h"
+#include "include/thread_pool.h"
+
+// 基于分块(tile)的光栅化器。
+// Submit根据三角形的屏幕包围盒将其分配(binning)到覆盖的tile中，
+// Flush在线程池上并行光栅化所有tile。
+// 每个tile独占深度缓冲中连续的一段以及画布上互不重叠的像素区域，
+// 因此tile之间无需加锁；光栅化tile时深度从DepthBuffer的紧凑格式解码到
+// 线程私有的双精度工作缓冲，完成后再编码写回，同一次Flush内的深度测试
+// 不受存储格式精度的影响。同一tile内三角形按提交顺序处理，
+// 结果与串行逐面光栅化完全一致。
+// 三角形建立(setup)阶段为每条边计算一次边函数 E(x,y) = a*x + b*y + c，
+// 光栅化时边函数沿行以加法递推，行内以8像素span为单位一次求出
+// 覆盖掩码与插值深度，只有通过测试的像素才调用片元着色器。
+// span的计算根据CPUID在运行时选择AVX2/SSE2/标量实现，三者结果逐位一致。
+// 边界像素采用top-left填充规则：恰好落在边上的像素只属于以该边为
+// 左边或上边的三角形，相邻三角形的公共边既不会重复绘制也不会遗漏。
+// 深度缓冲之外另外维护层次深度：每个8x8块以及每个tile记录其中
+// 最远(最小)的深度值。三角形在块/tile范围内的最近深度仍不超过该值时，
+// 整块/整个三角形在逐像素计算之前就被剔除。
+// 定点模式下顶点在建立阶段对齐到1/256像素的网格，覆盖测试完全用
+// 64位整数进行，公共边的判定与机器和编译选项无关，渲染结果可逐位复现。
+class Rasterizer {
+ public:
+  static constexpr int kTileSize = DepthBuffer::kTileSize;
+  static constexpr int kSpanWidth = 8;
+  // 层次深度块的边长，与span宽度相同，一个块即8行span
+  static constexpr int kBlockSize = kSpanWidth;
+  static constexpr int kTileBlocks = kTileSize / kBlockSize;
+
+  // 自上次Clear以来的统计
+  struct Stats {
+    // 通过建立阶段(非退化且与屏幕相交)的三角形数
+    long long triangles_submitted = 0;
+    // 在所有覆盖的tile中都被层次深度剔除的三角形数
+    long long triangles_culled = 0;
+    // 与三角形相交并进行了层次深度测试的块数
+    long long blocks_tested = 0;
+    // 被层次深度剔除的块数
+    long long blocks_culled = 0;
+    // 以下三项只在Profiler(见profiler.h)开启时统计
+    // 被三角形覆盖、进行了深度测试的像素数
+    long long pixels_tested = 0;
+    // 通过深度测试的像素数，每个这样的像素调用一次片元着色器
+    long long depth_passed = 0;
+    long long depth_failed = 0;
+  };
+
+  enum SimdLevel {
+    kScalar = 0,
+    kSse2 = 1,
+    kAvx2 = 2,
+  };
+  // 覆盖测试使用的数值表示
+  enum PrecisionMode {
+    kFloatingPoint = 0,
+    // 坐标对齐到kSubPixelBits位亚像素精度，边函数为64位整数
+    kFixedPoint = 1,
+  };
+  static constexpr int kSubPixelBits = 8;
+
+  // @param pool 为nullptr时在调用线程中逐个光栅化tile，
+  //   用于多个光栅化器各自在一个线程中工作的场合
+  Rasterizer(int width, int height, ThreadPool* pool,
+             DepthBuffer::Format depth_format = DepthBuffer::kFloat32);
+  Rasterizer(const Rasterizer& rasterizer) = delete;
+  Rasterizer& operator=(const Rasterizer& rhs) = delete;
+  ~Rasterizer();
+
+  // 清空深度缓冲以及尚未光栅化的三角形，开始新的一帧。
+  // 深度缓冲只标记清除，开销与tile数成正比
+  void Clear();
+  // @param triangle 屏幕空间三角形，退化或完全位于屏幕外的三角形被丢弃
+  void Submit(const Triangle& triangle);
+  // 光栅化所有已提交的三角形，完成后清空分块列表。
+  // 按着色器的静态类型实例化：对final的着色器(如TextureShader)，
+  // fragment_process在内循环中被内联；传入IShader*时为虚函数调用。
+  // 新的着色器类型需要在rasterizer.cc末尾显式实例化。
+  template <typename Shader>
+  void Flush(Shader* shader);
+  SimdLevel GetSimdLevel() const;
+  // 指定span计算使用的指令集，高于CPU支持的级别时退回到支持的最高级别
+  void SetSimdLevel(SimdLevel level);
+  PrecisionMode GetPrecisionMode() const;
+  // 只影响此后提交的三角形
+  void SetPrecisionMode(PrecisionMode mode);
+  Stats GetStats() const;
+  const DepthBuffer& GetDepthBuffer() const { return depth_buffer_; }
+
+ private:
+  // 三角形建立阶段的结果，每个三角形只计算一次
+  // edge_a/b/c 三条边函数的系数，第k条边对应顶点k的对边，
+  //   三角形内部 E>=0，E_k/area即顶点k的重心坐标
+  // top_left 该边是否为左边或上边，决定E==0时是否覆盖
+  // z_a/b/c 深度在屏幕空间的平面方程
+  // fixed_a/b/c 定点模式下以1/2^(2*kSubPixelBits)为单位的边函数，
+  //   自变量为像素坐标；非左边/上边的常数项减1，覆盖条件统一为E>=0
+  struct TriangleSetup {
+    double edge_a[3];
+    double edge_b[3];
+    double edge_c[3];
+    bool top_left[3];
+    bool fixed_point;
+    std::int64_t fixed_a[3];
+    std::int64_t fixed_b[3];
+    std::int64_t fixed_c[3];
+    double z_a;
+    double z_b;
+    double z_c;
+    // 三个顶点中最近的深度
+    double z_max;
+    double inv_area;
+    int xmin;
+    int xmax;
+    int ymin;
+    int ymax;
+  };
+
+  template <typename Shader>
+  void RasterizeTile(int tile_index, Shader* shader);
+  // 在当前tile内光栅化三角形
+  // @return 三角形在该tile中是否未被层次深度剔除，
+  //   没有覆盖任何块的三角形(例如落在像素中心之间)不算被剔除
+  // @param zbuffer 该tile的工作深度缓冲，行主序
+  template <typename Shader>
+  bool RasterizeTriangle(const Triangle& triangle, const TriangleSetup& setup,
+                         int tile_index, double* zbuffer, Shader* shader,
+                         Stats* stats);
+  // 重新计算块内屏幕范围像素的最小深度
+  void UpdateBlockDepth(int tile_index, int block_index,
+                        const double* zbuffer);
+
+  int width_;
+  int height_;
+  int tiles_x_;
+  int tiles_y_;
+  ThreadPool* pool_;
+  SimdLevel simd_level_;
+  PrecisionMode precision_mode_;
+  std::vector<Triangle> triangles_;
+  std::vector<TriangleSetup> setups_;
+  // 每个tile覆盖的三角形下标，按提交顺序排列
+  std::vector<std::vector<int>> bins_;
+  DepthBuffer depth_buffer_;
+  // 每个块/tile中最远的深度，块按tile主序、tile内行主序排列，
+  // 在tile载入工作缓冲时重新计算；
+  // 完全位于屏幕外的块取double最大值，不参与tile最小值
+  std::vector<double> block_zmin_;
+  std::vector<double> tile_zmin_;
+  // 各tile的统计与未被剔除的三角形，Flush结束时合并
+  std::vector<Stats> tile_stats_;
+  std::vector<std::vector<int>> tile_visible_;
+  Stats stats_;
+};
+
+#endif  // RASTERIZER_H_
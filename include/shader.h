@@ -5,111 +5,82 @@
 #include <cmath>
 #include <string>
 
+#include "include/framebuffer.h"
 #include "include/geometry.h"
 #include "include/gl.h"
+#include "include/texture.h"
 #include "include/tga_image.h"
 
 class IShader {
  public:
+  // @return 裁剪空间坐标，透视除法与视口变换在图元装配阶段完成
   virtual Vector4 vertex_process(const Vector4& vertex) = 0;
+  // 光栅化阶段可能在多个线程上并行调用该函数，
+  // 当前三角形的逐顶点数据通过triangle传入而不是保存在着色器中
   virtual void fragment_process(const Vector2Int& fragment_coordinates,
-                                const Vector3& barycentric) = 0;
+                                const Vector3& barycentric,
+                                const Triangle& triangle) = 0;
   virtual ~IShader() {}
 };
 
-class TextureShader : public IShader {
+// 声明为final并在头文件中内联fragment_process，
+// 光栅化器按TextureShader实例化时片元着色可以内联进内循环
+// 纹理可以由着色器自己加载，也可以由多个着色器共享同一份只读纹理。
+class TextureShader final : public IShader {
  public:
   TextureShader() = delete;
   explicit TextureShader(const std::string& texture_file);
+  // @param texture 不转移所有权，生存期需长于着色器；
+  //   不同线程中的着色器可以同时采样
+  explicit TextureShader(const Texture* texture);
   TextureShader(const TextureShader& shader) = delete;
   TextureShader& operator=(const TextureShader& rhs) = delete;
   ~TextureShader();
   Vector4 vertex_process(const Vector4& vertex) override;
   void fragment_process(const Vector2Int& fragment_coordinates,
-                        const Vector3& barycentric) override;
+                        const Vector3& barycentric,
+                        const Triangle& triangle) override;
   void LookAt(const Vector3& camera_pos, const Vector3& gaze_direction,
               const Vector3& viewup);
   // @param near应该为负值，因为相机位于原点向-z轴
   void Projection(const double near);
-  void SetViewPort(const double screen_width, const double screen_height);
-  // 当前三角形三个顶点的纹理坐标 index [0,2]
-  void SetTextureCoordinates(const Vector2& coor, const int index);
-  void RegisterCanvas(TgaImage* canvas_ptr);
+  // @return 合成后的m_proj_ * m_camera_，供批量顶点处理使用
+  SMatrix4 GetMvp() const;
+  const Texture& GetTexture() const;
+  // 片元直接写入canvas，不检查坐标，光栅化器保证片元位于屏幕内
+  void RegisterCanvas(ColorBuffer* canvas_ptr);
   void UnregisterCanvas();
 
  protected:
   SMatrix4 m_camera_;
   SMatrix4 m_proj_;
-  SMatrix4 m_vp_;
-  TgaImage* canvas_ptr_ = nullptr;
+  // LookAt/Projection时预先合成，避免每个顶点做两次矩阵乘法
+  SMatrix4 m_mvp_;
+  ColorBuffer* canvas_ptr_ = nullptr;
 
  private:
-  std::array<Vector2, 3> texture_coordinates_;
-  TgaImage* texture_ptr_ = nullptr;
-  double w_ = 0, h_ = 0;
+  // 由texture_file构造时持有的纹理
+  Texture owned_texture_;
+  const Texture* texture_;
 };
 
-TextureShader::TextureShader(const std::string& texture_file)
-    : texture_coordinates_() {
-  m_camera_ = matrix_m::IMatrix4();
-  m_proj_ = matrix_m::IMatrix4();
-  m_vp_ = matrix_m::IMatrix4();
-
-  texture_ptr_ = new TgaImage();
-  texture_ptr_->ReadTgaFile(texture_file);
-  w_ = texture_ptr_->GetWidth();
-  h_ = texture_ptr_->GetHeight();
-}
-TextureShader::~TextureShader() {
-  canvas_ptr_ = nullptr;
-  delete texture_ptr_;
-  texture_ptr_ = nullptr;
-}
-Vector4 TextureShader::vertex_process(const Vector4& vertex) {
-  // printf("x:%f, y:%f, z:%f, w:%f\n", vertex[0], vertex[1], vertex[2],
-  //        vertex[3]);
-  Vector4 v = m_vp_ * m_proj_ * m_camera_ * vertex;
-  // printf("x:%f, y:%f, z:%f, w:%f \n", v[0] / v[3], v[1] / v[3], v[2] / v[3]);
-  return v / v[3];
-}
-void TextureShader::fragment_process(const Vector2Int& fragment_coordinates,
-                                     const Vector3& barycentric) {
-  // printf("x:%f, y:%f, z:%f\n", barycentric[0], barycentric[1],
-  // barycentric[2]);
-  double x = vector_m::Dot(barycentric, Vector3{texture_coordinates_[0][0],
-                                                texture_coordinates_[1][0],
-                                                texture_coordinates_[2][0]});
-  double y = vector_m::Dot(barycentric, Vector3{texture_coordinates_[0][1],
-                                                texture_coordinates_[1][1],
-                                                texture_coordinates_[2][1]});
-  canvas_ptr_->SetColor(
-      fragment_coordinates[0], fragment_coordinates[1],
-      texture_ptr_->GetColor(std::floor(x * w_), std::floor(y * h_)));
-}
-void TextureShader::LookAt(const Vector3& camera_pos,
-                           const Vector3& gaze_direction,
-                           const Vector3& viewup) {
-  m_camera_ = CameraTransM(camera_pos, gaze_direction, viewup);
-}
-
-void TextureShader::Projection(const double near) {
-  m_proj_ = ProjectionM(-1, 1, -1, 1, -5, -1, true);
+inline void TextureShader::fragment_process(
+    const Vector2Int& fragment_coordinates, const Vector3& barycentric,
+    const Triangle& triangle) {
+  const std::array<Vector2, 3>& uv = triangle.texture_coordinates;
+  const Vector3& bdx = triangle.barycentric_dx;
+  const Vector3& bdy = triangle.barycentric_dy;
+  double x = barycentric[0] * uv[0][0] + barycentric[1] * uv[1][0] +
+             barycentric[2] * uv[2][0];
+  double y = barycentric[0] * uv[0][1] + barycentric[1] * uv[1][1] +
+             barycentric[2] * uv[2][1];
+  // 纹理坐标在屏幕空间线性插值，偏导数在三角形内为常数
+  double dudx = bdx[0] * uv[0][0] + bdx[1] * uv[1][0] + bdx[2] * uv[2][0];
+  double dvdx = bdx[0] * uv[0][1] + bdx[1] * uv[1][1] + bdx[2] * uv[2][1];
+  double dudy = bdy[0] * uv[0][0] + bdy[1] * uv[1][0] + bdy[2] * uv[2][0];
+  double dvdy = bdy[0] * uv[0][1] + bdy[1] * uv[1][1] + bdy[2] * uv[2][1];
+  canvas_ptr_->At(fragment_coordinates[0], fragment_coordinates[1]) =
+      PixelRgb8::FromColor(texture_->Sample(x, y, dudx, dvdx, dudy, dvdy));
 }
 
-void TextureShader::SetViewPort(const double screen_width,
-                                const double screen_height) {
-  m_vp_ = ViewportTransM(screen_width, screen_height);
-}
-
-void TextureShader::SetTextureCoordinates(const Vector2& coor,
-                                          const int index) {
-  texture_coordinates_[index] = coor;
-}
-
-void TextureShader::RegisterCanvas(TgaImage* canvas_ptr) {
-  canvas_ptr_ = canvas_ptr;
-}
-
-void TextureShader::UnregisterCanvas() { canvas_ptr_ = nullptr; }
-
 #endif  // SHADER_H_
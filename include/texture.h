@@ -0,0 +1,174 @@
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+// 供着色器采样的纹理。
+// 由TgaImage构造，纹素统一转换为4字节BGRA(与TgaColor内存布局相同)，
+// 并按4x4纹素分块存放：一个块恰好64字节、对齐到一个缓存行，
+// 纹理坐标在屏幕上旋转或缩小时相邻采样仍大多落在同一缓存行内。
+// 采样不做边界检查以外的分支，双线性插值用32位整数的SWAR运算
+// 同时处理两个通道，便于编译器向量化。
+// GenerateMipmaps生成逐级减半的mip链，三线性过滤根据屏幕空间纹理坐标
+// 的偏导数选择LOD，远处/小物体只访问与其屏幕大小相称的低分辨率层级。
+class Texture {
+ public:
+  enum WrapMode {
+    kRepeat = 0,
+    kClampToEdge = 1,
+  };
+  enum FilterMode {
+    kNearest = 0,
+    kBilinear = 1,
+    // 相邻两个mip层级各做一次双线性插值后再按LOD的小数部分插值
+    kTrilinear = 2,
+  };
+
+  Texture();
+  explicit Texture(const TgaImage& image);
+  ~Texture();
+
+  int GetWidth() const { return levels_[0].width; }
+  int GetHeight() const { return levels_[0].height; }
+  int GetLevelNum() const { return static_cast<int>(levels_.size()); }
+  void SetWrapMode(WrapMode mode) { wrap_mode_ = mode; }
+  void SetFilterMode(FilterMode mode) { filter_mode_ = mode; }
+  // 用2x2盒式滤波逐级生成mip链直到1x1，每一级的各行在线程池上并行
+  // @param pool 为nullptr时在调用线程中生成
+  void GenerateMipmaps(ThreadPool* pool);
+
+  // 按当前过滤模式采样，kTrilinear时使用第0级
+  // @param u,v 纹理坐标，[0,1]以外的部分由环绕模式决定
+  TgaColor Sample(double u, double v) const {
+    return ToColor(kNearest == filter_mode_ ? SampleNearest(u, v, 0)
+                                            : SampleBilinear(u, v, 0));
+  }
+  // 按当前过滤模式采样，附带纹理坐标对屏幕x、y的偏导数用于选择LOD
+  TgaColor Sample(double u, double v, double dudx, double dvdx, double dudy,
+                  double dvdy) const {
+    if (kTrilinear != filter_mode_) return Sample(u, v);
+    return ToColor(
+        SampleTrilinear(u, v, ComputeLod(dudx, dvdx, dudy, dvdy)));
+  }
+  // 屏幕上一个像素在第0级纹理上跨越的纹素数取log2
+  double ComputeLod(double dudx, double dvdx, double dudy,
+                    double dvdy) const {
+    double w = levels_[0].width;
+    double h = levels_[0].height;
+    double rho2 = std::max(dudx * dudx * w * w + dvdx * dvdx * h * h,
+                           dudy * dudy * w * w + dvdy * dvdy * h * h);
+    return .5 * std::log2(rho2);
+  }
+
+  // @return BGRA打包的纹素，b位于最低字节
+  std::uint32_t SampleNearest(double u, double v, int level) const {
+    const Level& l = levels_[level];
+    int x = Wrap(static_cast<int>(std::floor(u * l.width)), l.width);
+    int y = Wrap(static_cast<int>(std::floor(v * l.height)), l.height);
+    return Fetch(l, x, y);
+  }
+  std::uint32_t SampleBilinear(double u, double v, int level) const {
+    const Level& l = levels_[level];
+    // 纹素中心位于(x+.5)/width
+    double fx = u * l.width - .5;
+    double fy = v * l.height - .5;
+    double x0 = std::floor(fx);
+    double y0 = std::floor(fy);
+    std::uint32_t tx = static_cast<std::uint32_t>((fx - x0) * 256);
+    std::uint32_t ty = static_cast<std::uint32_t>((fy - y0) * 256);
+    int x = static_cast<int>(x0);
+    int y = static_cast<int>(y0);
+    int xa = Wrap(x, l.width);
+    int xb = Wrap(x + 1, l.width);
+    int ya = Wrap(y, l.height);
+    int yb = Wrap(y + 1, l.height);
+    return Lerp(Lerp(Fetch(l, xa, ya), Fetch(l, xb, ya), tx),
+                Lerp(Fetch(l, xa, yb), Fetch(l, xb, yb), tx), ty);
+  }
+  std::uint32_t SampleTrilinear(double u, double v, double lod) const {
+    int max_level = static_cast<int>(levels_.size()) - 1;
+    if (lod <= 0) return SampleBilinear(u, v, 0);
+    if (lod >= max_level) return SampleBilinear(u, v, max_level);
+    int level = static_cast<int>(lod);
+    std::uint32_t t = static_cast<std::uint32_t>((lod - level) * 256);
+    return Lerp(SampleBilinear(u, v, level), SampleBilinear(u, v, level + 1),
+                t);
+  }
+  // @param x,y 已经过环绕处理的第0级纹素坐标
+  std::uint32_t Fetch(int x, int y) const { return Fetch(levels_[0], x, y); }
+
+  static TgaColor ToColor(std::uint32_t texel) {
+    return TgaColor(texel >> 16 & 0xFF, texel >> 8 & 0xFF, texel & 0xFF,
+                    texel >> 24);
+  }
+
+ private:
+  static constexpr int kBlockShift = 2;
+  static constexpr int kBlockSize = 1 << kBlockShift;
+  static constexpr int kBlockMask = kBlockSize - 1;
+
+  struct alignas(64) TexelBlock {
+    std::uint32_t texels[kBlockSize * kBlockSize];
+  };
+
+  // 一个mip层级
+  struct Level {
+    std::vector<TexelBlock> blocks;
+    int width = 0;
+    int height = 0;
+    int blocks_x = 0;
+
+    Level() = default;
+    Level(int level_width, int level_height);
+    std::uint32_t& At(int x, int y) {
+      return blocks[(y >> kBlockShift) * blocks_x + (x >> kBlockShift)]
+          .texels[((y & kBlockMask) << kBlockShift) | (x & kBlockMask)];
+    }
+    std::uint32_t At(int x, int y) const {
+      return blocks[(y >> kBlockShift) * blocks_x + (x >> kBlockShift)]
+          .texels[((y & kBlockMask) << kBlockShift) | (x & kBlockMask)];
+    }
+  };
+
+  static std::uint32_t Fetch(const Level& level, int x, int y) {
+    return level.At(x, y);
+  }
+
+  // 对四个8位通道同时插值：奇偶通道分别放在16位槽中，
+  // 255*256不会溢出到相邻槽
+  // @param t 插值权重，[0,256]
+  static std::uint32_t Lerp(std::uint32_t a, std::uint32_t b,
+                            std::uint32_t t) {
+    const std::uint32_t kMask = 0x00FF00FF;
+    std::uint32_t rb = ((a & kMask) * (256 - t) + (b & kMask) * t) >> 8;
+    std::uint32_t ga =
+        ((a >> 8 & kMask) * (256 - t) + (b >> 8 & kMask) * t) >> 8;
+    return (rb & kMask) | ((ga & kMask) << 8);
+  }
+
+  int Wrap(int coordinate, int size) const {
+    if (kClampToEdge == wrap_mode_) {
+      return coordinate < 0 ? 0 : (coordinate >= size ? size - 1 : coordinate);
+    }
+    coordinate %= size;
+    return coordinate < 0 ? coordinate + size : coordinate;
+  }
+
+  // levels_[0]为原始分辨率
+  std::vector<Level> levels_;
+  WrapMode wrap_mode_ = kRepeat;
+  FilterMode filter_mode_ = kNearest;
+};
+
+// 读取TGA文件生成纹理，并生成mip链、使用三线性过滤
+// @return 文件无法读取时为只有一个白色纹素的空纹理
+Texture LoadTexture(const std::string& filename, ThreadPool* pool);
+
+#endif  // TEXTURE_H_
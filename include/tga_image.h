@@ -2,11 +2,12 @@
 #define TGA_IMAGE_H_
 
 #include <cstdint>
-#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "include/thread_pool.h"
+
 // the 18-byte header storing packed RGB data in a 24-bit TGA file
 // 设置1个字节对齐，方便读写
 #pragma pack(push, 1)
@@ -91,25 +92,63 @@ class TgaImage {
   TgaImage();
   TgaImage(int width, int height, int bytespp);
   TgaImage(const TgaImage& image);
+  TgaImage& operator=(const TgaImage& rhs);
   ~TgaImage();
+  // 改为width x height、bytespp字节每像素的图像，复用已分配的内存。
+  // 原有的像素内容不保留，调用者需要重新写入所有像素
+  void Reset(int width, int height, int bytespp);
   int GetWidth() const;
   int GetHeight() const;
   int GetBytespp() const;
-  bool ReadTgaFile(const std::string& filename);
+  // 像素数据，各行自下而上紧密排列，不考虑尚未应用的翻转
+  std::uint8_t* GetData();
+  const std::uint8_t* GetData() const;
+  // GetData()中的像素数据相对于图像坐标是否水平/垂直翻转
+  bool GetStoredFlipHorizontal() const;
+  bool GetStoredFlipVertical() const;
+  // 文件整体映射到内存后解析，未压缩的像素数据只复制一次，
+  // RLE数据直接在映射上解码。
+  // 图像统一以左下角为原点，描述字节表明原点在右侧/上方时需要翻转
+  // @param resolve_orientation 为false时不翻转像素数据，只记录下翻转，
+  //   GetColor/SetColor访问时再换算坐标，读取时省去一次整图遍历
+  bool ReadTgaFile(const std::string& filename,
+                   bool resolve_orientation = true);
+  // filename为"-"时写到标准输出。
+  // 翻转只写入header的描述字节，不改动像素数据；
+  // 尚未应用的翻转(见ReadTgaFile)同样写入描述字节，读回的图像不变
+  // @param horizontal_flip, vertical_flip 显示时是否水平/垂直翻转
+  // @param rle 为true时按行带并行编码，相邻像素是否相同用SIMD逐行比较
+  // @param pool 为nullptr时在调用线程中编码
   bool WriteTgaFile(const std::string& filename, bool horizontal_flip,
-                    bool vertical_flip, bool rle) const;
-  bool DecompressRLE(std::ifstream& in, const std::size_t bytes_num,
-                     const int bytespp);
-  bool FlipHorizontally();
-  bool FlipVertically();
+                    bool vertical_flip, bool rle,
+                    ThreadPool* pool = nullptr) const;
+  // 从内存中的RLE包解码出bytes_num字节的像素数据
+  // @param packets, size RLE数据及其长度，解码不会越过packets + size
+  // @return 数据不完整或包超出图像大小时返回false
+  bool DecompressRLE(const std::uint8_t* packets, std::size_t size,
+                     std::size_t bytes_num, int bytespp);
+  // 原地翻转像素数据，图像较大且给出线程池时按行带并行
+  bool FlipHorizontally(ThreadPool* pool = nullptr);
+  bool FlipVertically(ThreadPool* pool = nullptr);
+  // 应用ReadTgaFile中记录下的翻转，之后访问像素不再换算坐标
+  void ResolveOrientation(ThreadPool* pool = nullptr);
   void SetColor(int x, int y, const TgaColor& color);
   TgaColor GetColor(int x, int y) const;
+  // 所有像素置0，不重新分配内存
+  void Clear();
 
  private:
+  // @return 按行带划分的RLE数据，依次拼接即为完整的图像数据
+  std::vector<std::vector<std::uint8_t>> EncodeRle(ThreadPool* pool) const;
+
   std::vector<std::uint8_t> data_;
   int width_;
   int height_;
   int bytespp_;
+  // 像素数据相对于图像坐标是否水平/垂直翻转，只在不立即应用翻转的
+  // ReadTgaFile之后为true
+  bool stored_flip_horizontal_ = false;
+  bool stored_flip_vertical_ = false;
 };
 
 #endif  // TGA_IMAGE_H_
@@ -0,0 +1,91 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing线程池。
+// 每个工作线程拥有自己的任务队列：从队尾取自己的任务(LIFO,
+// 缓存友好)，自己队列为空时从其他线程队首窃取(FIFO)。
+// ParallelFor的调用线程在等待期间也会执行队列中的任务，
+// 因此允许在任务内部嵌套调用ParallelFor而不会死锁。
+class ThreadPool {
+ public:
+  // @param thread_num 工作线程数，<= 0 时使用硬件并发数
+  explicit ThreadPool(int thread_num = 0);
+  ThreadPool(const ThreadPool& pool) = delete;
+  ThreadPool& operator=(const ThreadPool& rhs) = delete;
+  ~ThreadPool();
+
+  int GetThreadNum() const;
+  // 对[begin, end)中每个下标调用func，全部完成后返回
+  void ParallelFor(int begin, int end, const std::function<void(int)>& func);
+
+  // 进程内共享的线程池
+  static ThreadPool& Global();
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void Push(std::function<void()> task);
+  // 优先从queue_index对应的队列尾部取任务，否则从其他队列头部窃取
+  bool Pop(int queue_index, std::function<void()>& task);
+  void WorkerLoop(int index);
+
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic<int> queued_{0};
+  std::atomic<unsigned> next_queue_{0};
+  bool stop_ = false;
+};
+
+// 按行带划分图像类的工作。
+// 每个线程(含调用线程)分到kRowBandsPerThread个行带，行带多于线程数时
+// 各线程的负载更均衡；数据量小于kMinParallelRowBytes时并行的开销
+// 超过收益，只划分为一个行带
+constexpr int kRowBandsPerThread = 4;
+constexpr std::size_t kMinParallelRowBytes = 1 << 20;
+
+// row_num行、共bytes字节的数据划分的行带数，至少为1。
+// pool为nullptr或数据量较小时为1
+// @param min_band_rows 每个行带至少的行数
+// @param max_band_num 行带数上限
+int GetRowBandNum(int row_num, std::size_t bytes, ThreadPool* pool,
+                  int min_band_rows = 1,
+                  int max_band_num = std::numeric_limits<int>::max());
+
+// 把[0, row_num)等分为band_num个行带时第band个行带的起始行，
+// band等于band_num时为row_num
+inline int GetRowBandBegin(int row_num, int band, int band_num) {
+  return static_cast<int>(static_cast<long long>(row_num) * band / band_num);
+}
+
+// 对每个行带调用func(band, begin, end)，band_num大于1时在pool上并行
+template <typename Func>
+void ForEachRowBand(int row_num, int band_num, ThreadPool* pool,
+                    const Func& func) {
+  auto run = [row_num, band_num, &func](int band) {
+    func(band, GetRowBandBegin(row_num, band, band_num),
+         GetRowBandBegin(row_num, band + 1, band_num));
+  };
+  if (1 < band_num) {
+    pool->ParallelFor(0, band_num, run);
+  } else {
+    run(0);
+  }
+}
+
+#endif  // THREAD_POOL_H_
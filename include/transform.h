@@ -0,0 +1,34 @@
+#ifndef TRANSFORM_H_
+#define TRANSFORM_H_
+
+#include "include/geometry.h"
+#include "include/thread_pool.h"
+
+// 批量变换结构数组(SoA)形式存放的点。
+// 每个点的计算相互独立，按CPUID在运行时选择AVX2(一次4个点)或标量实现，
+// 两者都不使用FMA、运算顺序相同，结果逐位一致；
+// 点数较多且给出线程池时分段并行。
+namespace transform_m {
+// 只读的一组点，w为nullptr时各点的w都为1
+struct ConstPointSpan {
+  const double* x;
+  const double* y;
+  const double* z;
+  const double* w;
+};
+
+// 输出的一组点，可以与输入指向同一数组
+struct PointSpan {
+  double* x;
+  double* y;
+  double* z;
+  double* w;
+};
+
+// out[i] = m * in[i]
+// @param pool 为nullptr时在当前线程计算
+void Transform(const SMatrix4& m, const ConstPointSpan& in, int count,
+               const PointSpan& out, ThreadPool* pool = nullptr);
+}  // namespace transform_m
+
+#endif  // TRANSFORM_H_
@@ -0,0 +1,44 @@
+#ifndef VERTEX_STAGE_H_
+#define VERTEX_STAGE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "include/geometry.h"
+#include "include/indexed_mesh.h"
+#include "include/thread_pool.h"
+
+// 批量顶点处理阶段(post-transform vertex cache)。
+// 构造时把IndexedMesh的顶点坐标按SoA(x[],y[],z[])复制一份，
+// Process对每个顶点只做一次MVP变换，结果同样按SoA存放，
+// 面循环通过顶点索引直接取用，顶点处理的开销与顶点数而不是
+// 3倍面数成正比。顶点按(v, vt, vn)组合去重，纹理接缝处同一位置
+// 会被变换多次。变换由transform_m::Transform批量完成。
+class VertexStage {
+ public:
+  VertexStage(const IndexedMesh& mesh, ThreadPool* pool);
+  VertexStage(const VertexStage& stage) = delete;
+  VertexStage& operator=(const VertexStage& rhs) = delete;
+  ~VertexStage();
+
+  // @param mvp 预先合成好的模型-观察-投影矩阵，每次绘制只合成一次
+  void Process(const SMatrix4& mvp);
+  std::size_t GetVertexNum() const;
+  // @return 第index个顶点的裁剪空间坐标
+  Vector4 GetClipVertex(int index) const {
+    return Vector4{clip_x_[index], clip_y_[index], clip_z_[index],
+                   clip_w_[index]};
+  }
+
+ private:
+  ThreadPool* pool_;
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> z_;
+  std::vector<double> clip_x_;
+  std::vector<double> clip_y_;
+  std::vector<double> clip_z_;
+  std::vector<double> clip_w_;
+};
+
+#endif  // VERTEX_STAGE_H_
@@ -0,0 +1,197 @@
+#include "include/batch_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "include/frame_writer.h"
+#include "include/framebuffer.h"
+#include "include/geometry.h"
+#include "include/image_encoder.h"
+#include "include/gl.h"
+#include "include/indexed_mesh.h"
+#include "include/primitive_assembler.h"
+#include "include/profiler.h"
+#include "include/rasterizer.h"
+#include "include/shader.h"
+#include "include/texture.h"
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+#include "include/vertex_stage.h"
+
+bool ParseCamera(const std::string& text, Camera* camera) {
+  double values[9];
+  const char* p = text.c_str();
+  for (int i = 0; i < 9; ++i) {
+    while (' ' == *p || '\t' == *p || (',' == *p && 0 < i)) ++p;
+    char* end = nullptr;
+    values[i] = std::strtod(p, &end);
+    if (end == p) return false;
+    p = end;
+  }
+  while (' ' == *p || '\t' == *p || '\r' == *p) ++p;
+  if ('\0' != *p) return false;
+  camera->position = Vector3{values[0], values[1], values[2]};
+  camera->gaze_direction = Vector3{values[3], values[4], values[5]};
+  camera->up = Vector3{values[6], values[7], values[8]};
+  return true;
+}
+
+bool ReadCameraFile(const std::string& filename,
+                    std::vector<Camera>* cameras) {
+  std::ifstream in(filename);
+  if (!in.is_open()) {
+    std::cerr << "Can't open file " << filename << ".\n";
+    return false;
+  }
+  std::string line;
+  for (int line_num = 1; std::getline(in, line); ++line_num) {
+    std::size_t begin = line.find_first_not_of(" \t\r");
+    if (std::string::npos == begin || '#' == line[begin]) continue;
+    Camera camera;
+    if (!ParseCamera(line.substr(begin), &camera)) {
+      std::cerr << "Invalid camera at " << filename << ":" << line_num
+                << ".\n";
+      return false;
+    }
+    cameras->push_back(camera);
+  }
+  return true;
+}
+
+// 一帧需要的全部可变状态，帧之间互不共享
+struct BatchRenderer::Frame {
+  Frame(const IndexedMesh& mesh, const Texture* texture, int width,
+        int height)
+      : shader(texture),
+        rasterizer(width, height, nullptr),
+        assembler(width, height),
+        vertex_stage(mesh, nullptr) {
+    shader.Projection(-1.5);
+    assembler.SetCullMode(PrimitiveAssembler::kCullBack);
+    assembler.SetFrontFace(PrimitiveAssembler::kCounterClockwise);
+  }
+
+  TextureShader shader;
+  Rasterizer rasterizer;
+  PrimitiveAssembler assembler;
+  VertexStage vertex_stage;
+};
+
+BatchRenderer::BatchRenderer(const IndexedMesh* mesh, const Texture* texture,
+                             int width, int height, ThreadPool* pool)
+    : mesh_(mesh),
+      texture_(texture),
+      width_(width),
+      height_(height),
+      pool_(pool) {}
+
+BatchRenderer::~BatchRenderer() = default;
+
+BatchRenderer::Stats BatchRenderer::Render(
+    const std::vector<Camera>& cameras, const std::string& filename_prefix) {
+  auto begin = std::chrono::steady_clock::now();
+  Stats stats;
+  std::string extension = "." + encoder_->GetExtension();
+  // 同时渲染的帧数为工作线程数加上参与执行任务的调用线程
+  FrameWriter writer(width_, height_,
+                     pool_->GetThreadNum() + 1 +
+                         kWriterThreadNum * kBuffersPerWriter,
+                     kWriterThreadNum, encoder_);
+  pool_->ParallelFor(
+      0, static_cast<int>(cameras.size()),
+      [this, &cameras, &filename_prefix, &extension, &writer,
+       &stats](int i) {
+        ColorBuffer* canvas = writer.Acquire();
+        Frame* frame = AcquireFrame();
+        auto frame_begin = std::chrono::steady_clock::now();
+        RenderFrame(cameras[i], i, frame, canvas);
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - frame_begin)
+                             .count();
+        ReleaseFrame(frame);
+        std::string number = std::to_string(i);
+        if (number.size() < 4) number.insert(0, 4 - number.size(), '0');
+        writer.Submit(canvas, filename_prefix + number + extension, i);
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.render_seconds += seconds;
+      });
+  writer.Wait();
+  stats.writer = writer.GetStats();
+  stats.frames = stats.writer.frames_written;
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - begin)
+                      .count();
+  return stats;
+}
+
+int BatchRenderer::GetFramePoolSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(frames_.size());
+}
+
+BatchRenderer::Frame* BatchRenderer::AcquireFrame() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_frames_.empty()) {
+      Frame* frame = free_frames_.back();
+      free_frames_.pop_back();
+      return frame;
+    }
+  }
+  // 帧上下文的构造(复制顶点坐标、分配缓冲)不需要持有锁
+  std::unique_ptr<Frame> frame(
+      new Frame(*mesh_, texture_, width_, height_));
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_.push_back(std::move(frame));
+  return frames_.back().get();
+}
+
+void BatchRenderer::ReleaseFrame(Frame* frame) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_frames_.push_back(frame);
+}
+
+void BatchRenderer::RenderFrame(const Camera& camera, int index,
+                                Frame* frame, ColorBuffer* canvas) const {
+  canvas->Fill(PixelRgb8{0, 0, 0});
+  frame->shader.RegisterCanvas(canvas);
+  frame->rasterizer.Clear();
+  frame->assembler.ResetStats();
+  frame->shader.LookAt(camera.position, camera.gaze_direction, camera.up);
+  {
+    ScopedTimer timer(Profiler::kVertexProcessing, index);
+    frame->vertex_stage.Process(frame->shader.GetMvp());
+  }
+
+  {
+    ScopedTimer timer(Profiler::kPrimitiveAssembly, index);
+    const std::vector<std::uint32_t>& indices = mesh_->GetIndices();
+    Triangle triangle;
+    for (std::size_t i = 0; i < indices.size(); i += 3) {
+      for (int k = 0; k < 3; ++k) {
+        int vertex = indices[i + k];
+        const double* uv = mesh_->GetVertex(vertex).texture_coordinates;
+        triangle.vertices[k] = frame->vertex_stage.GetClipVertex(vertex);
+        triangle.texture_coordinates[k] = Vector2{uv[0], uv[1]};
+      }
+      frame->assembler.Assemble(triangle, &frame->rasterizer);
+    }
+  }
+  {
+    ScopedTimer timer(Profiler::kRasterization, index);
+    frame->rasterizer.Flush(&frame->shader);
+  }
+  frame->shader.UnregisterCanvas();
+  if (Profiler::Global().IsEnabled()) {
+    Profiler::Global().AddRenderStats(index, frame->assembler.GetStats(),
+                                      frame->rasterizer.GetStats());
+  }
+}
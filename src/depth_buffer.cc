@@ -0,0 +1,135 @@
+#include "include/depth_buffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+// 定点格式的最大编码值，编码1..kMax对应深度[-1,1]
+template <typename T, int kBits>
+struct Unorm {
+  static constexpr std::uint32_t kMax = (1u << kBits) - 1;
+  static constexpr double kScale = (kMax - 1) * .5;
+  static constexpr double kInvScale = 1. / kScale;
+
+  static T Encode(double z) {
+    if (DepthBuffer::kClearDepth == z) return 0;
+    z = std::min(1., std::max(-1., z));
+    return static_cast<T>(1 + static_cast<std::uint32_t>(
+                                  (z + 1.) * kScale + .5));
+  }
+  static double Decode(T q) {
+    return 0 == q ? DepthBuffer::kClearDepth : (q - 1) * kInvScale - 1.;
+  }
+};
+
+using Unorm24 = Unorm<std::uint32_t, 24>;
+using Unorm16 = Unorm<std::uint16_t, 16>;
+
+// 单精度浮点可以直接表示清除值(负无穷)
+struct Float32 {
+  static float Encode(double z) { return static_cast<float>(z); }
+  static double Decode(float q) { return q; }
+};
+
+template <typename Codec, typename T>
+void DecodeTile(const T* data, double* depth) {
+  for (int i = 0; i < DepthBuffer::kTilePixels; ++i) {
+    depth[i] = Codec::Decode(data[i]);
+  }
+}
+
+template <typename Codec, typename T>
+void EncodeTile(const double* depth, T* data) {
+  for (int i = 0; i < DepthBuffer::kTilePixels; ++i) {
+    data[i] = Codec::Encode(depth[i]);
+  }
+}
+}  // namespace
+
+DepthBuffer::DepthBuffer(int width, int height, Format format)
+    : width_(width),
+      height_(height),
+      tiles_x_((width + kTileSize - 1) / kTileSize),
+      tiles_y_((height + kTileSize - 1) / kTileSize),
+      format_(format),
+      cleared_(tiles_x_ * tiles_y_, 1) {
+  std::size_t pixel_num =
+      static_cast<std::size_t>(tiles_x_ * tiles_y_) * kTilePixels;
+  switch (format_) {
+    case kFloat32:
+      float_data_.resize(pixel_num);
+      break;
+    case kUnorm24:
+      unorm24_data_.resize(pixel_num);
+      break;
+    case kUnorm16:
+      unorm16_data_.resize(pixel_num);
+      break;
+  }
+}
+
+DepthBuffer::~DepthBuffer() = default;
+
+int DepthBuffer::GetBytesPerPixel() const {
+  return kUnorm16 == format_ ? 2 : 4;
+}
+
+std::size_t DepthBuffer::GetSize() const {
+  return static_cast<std::size_t>(GetTileNum()) * kTilePixels *
+         GetBytesPerPixel();
+}
+
+void DepthBuffer::Clear() { std::fill(cleared_.begin(), cleared_.end(), 1); }
+
+void DepthBuffer::LoadTile(int tile_index, double* depth) const {
+  if (cleared_[tile_index]) {
+    std::fill(depth, depth + kTilePixels, kClearDepth);
+    return;
+  }
+  std::size_t offset = static_cast<std::size_t>(tile_index) * kTilePixels;
+  switch (format_) {
+    case kFloat32:
+      DecodeTile<Float32>(float_data_.data() + offset, depth);
+      break;
+    case kUnorm24:
+      DecodeTile<Unorm24>(unorm24_data_.data() + offset, depth);
+      break;
+    case kUnorm16:
+      DecodeTile<Unorm16>(unorm16_data_.data() + offset, depth);
+      break;
+  }
+}
+
+void DepthBuffer::StoreTile(int tile_index, const double* depth) {
+  std::size_t offset = static_cast<std::size_t>(tile_index) * kTilePixels;
+  switch (format_) {
+    case kFloat32:
+      EncodeTile<Float32>(depth, float_data_.data() + offset);
+      break;
+    case kUnorm24:
+      EncodeTile<Unorm24>(depth, unorm24_data_.data() + offset);
+      break;
+    case kUnorm16:
+      EncodeTile<Unorm16>(depth, unorm16_data_.data() + offset);
+      break;
+  }
+  cleared_[tile_index] = 0;
+}
+
+double DepthBuffer::GetDepth(int x, int y) const {
+  if (0 > x || 0 > y || x >= width_ || y >= height_) return kClearDepth;
+  int tile_index = y / kTileSize * tiles_x_ + x / kTileSize;
+  if (cleared_[tile_index]) return kClearDepth;
+  std::size_t index = static_cast<std::size_t>(tile_index) * kTilePixels +
+                      y % kTileSize * kTileSize + x % kTileSize;
+  switch (format_) {
+    case kFloat32:
+      return Float32::Decode(float_data_[index]);
+    case kUnorm24:
+      return Unorm24::Decode(unorm24_data_[index]);
+    case kUnorm16:
+      return Unorm16::Decode(unorm16_data_[index]);
+  }
+  return kClearDepth;
+}
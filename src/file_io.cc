@@ -0,0 +1,60 @@
+#include "include/file_io.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+bool WriteAll(int fd, iovec* iov, int iov_num) {
+  while (true) {
+    // 跳过长度为0的iovec，之后若还有iovec就一定还有数据未写出
+    while (0 < iov_num && 0 == iov->iov_len) {
+      ++iov;
+      --iov_num;
+    }
+    if (0 == iov_num) return true;
+    ssize_t written = writev(fd, iov, std::min(iov_num, IOV_MAX));
+    if (0 > written) {
+      if (EINTR == errno) continue;
+      return false;
+    }
+    // 有数据却没有写出任何字节，重试也不会有进展
+    if (0 == written) {
+      errno = EIO;
+      return false;
+    }
+    while (0 < iov_num && static_cast<std::size_t>(written) >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --iov_num;
+    }
+    if (0 < iov_num) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+bool WriteFile(const std::string& filename, std::vector<iovec>* iov) {
+  bool to_stdout = "-" == filename;
+  int fd = to_stdout ? STDOUT_FILENO
+                     : open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                            0644);
+  if (-1 == fd) {
+    std::cerr << "Can't open file " << filename << ".\n";
+    return false;
+  }
+  bool ok = WriteAll(fd, iov->data(), static_cast<int>(iov->size()));
+  if (!ok) {
+    std::cerr << "An error occurred while writing file " << filename << ".\n";
+  }
+  if (!to_stdout) close(fd);
+  return ok;
+}
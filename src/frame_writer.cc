@@ -0,0 +1,106 @@
+#include "include/frame_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "include/framebuffer.h"
+#include "include/image_encoder.h"
+#include "include/profiler.h"
+#include "include/tga_image.h"
+
+FrameWriter::FrameWriter(int width, int height, int buffer_num,
+                         int thread_num, const ImageEncoder* encoder)
+    : encoder_(encoder) {
+  for (int i = 0; i < std::max(1, buffer_num); ++i) {
+    buffers_.emplace_back(new ColorBuffer(width, height));
+    free_buffers_.push_back(buffers_.back().get());
+  }
+  for (int i = 0; i < std::max(1, thread_num); ++i) {
+    threads_.emplace_back(&FrameWriter::WriterLoop, this);
+  }
+}
+
+FrameWriter::~FrameWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads_) thread.join();
+}
+
+ColorBuffer* FrameWriter::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (free_buffers_.empty()) {
+    auto begin = std::chrono::steady_clock::now();
+    cv_.wait(lock, [this] { return !free_buffers_.empty(); });
+    stats_.stall_seconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - begin)
+                                .count();
+  }
+  ColorBuffer* canvas = free_buffers_.back();
+  free_buffers_.pop_back();
+  return canvas;
+}
+
+void FrameWriter::Submit(ColorBuffer* canvas, const std::string& filename,
+                         int frame) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(Job{canvas, filename, frame});
+  }
+  cv_.notify_all();
+}
+
+void FrameWriter::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return jobs_.empty() && 0 == writing_; });
+}
+
+FrameWriter::Stats FrameWriter::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void FrameWriter::WriterLoop() {
+  // 写线程各自的输出图像，大小不变时在帧之间复用
+  TgaImage image;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return !jobs_.empty() || stop_; });
+    // 停止前先写完队列中剩余的帧
+    if (jobs_.empty()) return;
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    ++writing_;
+    lock.unlock();
+
+    auto begin = std::chrono::steady_clock::now();
+    bool ok = false;
+    {
+      ScopedTimer timer(Profiler::kImageWrite, job.frame);
+      job.canvas->ToTgaImage(&image);
+      // 转换完画布就可以交给下一帧，不必等文件写完
+      lock.lock();
+      free_buffers_.push_back(job.canvas);
+      lock.unlock();
+      cv_.notify_all();
+      // 写线程本身并发，每帧在各自的线程中编码
+      ok = encoder_->Write(image, job.filename, nullptr);
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+
+    lock.lock();
+    --writing_;
+    stats_.write_seconds += seconds;
+    ++(ok ? stats_.frames_written : stats_.frames_failed);
+    cv_.notify_all();
+  }
+}
@@ -0,0 +1,112 @@
+#include "include/framebuffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+namespace {
+// 所有字节都相同的像素可以用memset填充
+template <typename Pixel>
+bool IsByteSplat(const Pixel& value) {
+  const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(&value);
+  return std::all_of(bytes, bytes + sizeof(Pixel),
+                     [bytes](std::uint8_t byte) { return byte == bytes[0]; });
+}
+}  // namespace
+
+template <typename Pixel>
+Framebuffer<Pixel>::Framebuffer(int width, int height)
+    : width_(width),
+      height_(height),
+      stride_((width * sizeof(Pixel) + kRowAlignment - 1) / kRowAlignment *
+              kRowAlignment),
+      lines_(stride_ / kRowAlignment * height) {}
+
+template <typename Pixel>
+Framebuffer<Pixel>::~Framebuffer() = default;
+
+template <typename Pixel>
+void Framebuffer<Pixel>::Fill(const Pixel& value, ThreadPool* pool) {
+  if (IsByteSplat(value)) {
+    // 行尾的填充字节一起置值，整个缓冲是一段连续内存
+    std::uint8_t byte = *reinterpret_cast<const std::uint8_t*>(&value);
+    std::uint8_t* data = reinterpret_cast<std::uint8_t*>(lines_.data());
+    ForEachRowBand(height_, GetRowBandNum(height_, stride_ * height_, pool),
+                   pool, [this, data, byte](int, int begin, int end) {
+                     std::memset(data + begin * stride_, byte,
+                                 (end - begin) * stride_);
+                   });
+    return;
+  }
+  ForEachRowBand(height_, GetRowBandNum(height_, stride_ * height_, pool),
+                 pool, [this, &value](int, int begin, int end) {
+                   if (begin == end) return;
+                   // 行带的第一行逐像素填充，其余各行整行复制
+                   std::fill(GetRow(begin), GetRow(begin) + width_, value);
+                   for (int y = begin + 1; y < end; ++y) {
+                     std::memcpy(GetRow(y), GetRow(begin),
+                                 width_ * sizeof(Pixel));
+                   }
+                 });
+}
+
+template <typename Pixel>
+void Framebuffer<Pixel>::FillRect(int x, int y, int width, int height,
+                                  const Pixel& value) {
+  int x0 = std::max(0, x);
+  int y0 = std::max(0, y);
+  int x1 = std::min(width_, x + width);
+  int y1 = std::min(height_, y + height);
+  for (int j = y0; j < y1; ++j) {
+    std::fill(GetRow(j) + x0, GetRow(j) + std::max(x0, x1), value);
+  }
+}
+
+template <typename Pixel>
+void Framebuffer<Pixel>::Blit(const Framebuffer& source, int source_x,
+                              int source_y, int width, int height, int x,
+                              int y) {
+  // 先按源缓冲裁剪，再按目标缓冲裁剪，两侧的偏移同步调整
+  int left = std::max(std::max(0, -source_x), -x);
+  int bottom = std::max(std::max(0, -source_y), -y);
+  int right = std::min(std::min(width, source.width_ - source_x), width_ - x);
+  int top =
+      std::min(std::min(height, source.height_ - source_y), height_ - y);
+  if (left >= right || bottom >= top) return;
+  for (int j = bottom; j < top; ++j) {
+    std::memcpy(GetRow(y + j) + x + left,
+                source.GetRow(source_y + j) + source_x + left,
+                (right - left) * sizeof(Pixel));
+  }
+}
+
+template <typename Pixel>
+void Framebuffer<Pixel>::ToTgaImage(TgaImage* image, ThreadPool* pool) const {
+  const int kBytespp = Pixel::kTgaFormat;
+  image->Reset(width_, height_, kBytespp);
+  std::uint8_t* data = image->GetData();
+  std::size_t row_bytes = static_cast<std::size_t>(width_) * kBytespp;
+  ForEachRowBand(height_, GetRowBandNum(height_, row_bytes * height_, pool),
+                 pool, [this, data, row_bytes](int, int begin, int end) {
+                   for (int y = begin; y < end; ++y) {
+                     std::uint8_t* dst = data + y * row_bytes;
+                     if (Pixel::kTgaLayout) {
+                       std::memcpy(dst, GetRow(y), row_bytes);
+                       continue;
+                     }
+                     const Pixel* row = GetRow(y);
+                     for (int x = 0; x < width_; ++x) {
+                       row[x].ToTga(dst + x * kBytespp);
+                     }
+                   }
+                 });
+}
+
+template class Framebuffer<PixelR8>;
+template class Framebuffer<PixelRgb8>;
+template class Framebuffer<PixelRgba8>;
+template class Framebuffer<PixelRgbaF>;
@@ -0,0 +1,700 @@
+#include "include/image_encoder.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "include/file_io.h"
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// PNG行带的最少行数，行带过小时LZ77窗口被切断得太频繁，压缩率下降
+const int kMinPngBandRows = 16;
+
+bool CheckImage(const TgaImage& image) {
+  int bytespp = image.GetBytespp();
+  if (0 >= image.GetWidth() || 0 >= image.GetHeight()) {
+    std::cerr << "Can't encode an empty image.\n";
+    return false;
+  }
+  if (TgaImage::kGrayscale != bytespp && TgaImage::kRGB != bytespp &&
+      TgaImage::kRGBA != bytespp) {
+    std::cerr << "Unsupported bytespp " << bytespp << ".\n";
+    return false;
+  }
+  return true;
+}
+
+// 把TgaImage中自上而下的第row行(BGR[A]或灰度)转换为channels通道的
+// RGB[A]或灰度，尚未应用的翻转在选取源行与源像素时应用。
+// channels为1时要求图像为灰度
+void ConvertRow(const TgaImage& image, int row, int channels,
+                std::uint8_t* dst) {
+  int width = image.GetWidth();
+  int bytespp = image.GetBytespp();
+  // 数据自下而上存放，垂直翻转时数据中的第row行就是自上而下的第row行
+  int src_row =
+      image.GetStoredFlipVertical() ? row : image.GetHeight() - 1 - row;
+  const std::uint8_t* src =
+      image.GetData() + static_cast<std::size_t>(src_row) * width * bytespp;
+  std::ptrdiff_t step = bytespp;
+  if (image.GetStoredFlipHorizontal()) {
+    src += static_cast<std::size_t>(width - 1) * bytespp;
+    step = -step;
+  } else if (channels == bytespp && TgaImage::kGrayscale == bytespp) {
+    std::memcpy(dst, src, width);
+    return;
+  }
+  for (int x = 0; x < width; ++x, src += step, dst += channels) {
+    if (1 == channels) {
+      dst[0] = src[0];
+    } else if (TgaImage::kGrayscale == bytespp) {
+      dst[0] = dst[1] = dst[2] = src[0];
+    } else {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+    }
+    if (4 == channels) dst[3] = TgaImage::kRGBA == bytespp ? src[3] : 255;
+  }
+}
+
+// 按行带并行转换整幅图像，行自上而下紧密排列
+std::vector<std::uint8_t> ConvertImage(const TgaImage& image, int channels,
+                                       ThreadPool* pool) {
+  int height = image.GetHeight();
+  std::size_t row_bytes = static_cast<std::size_t>(image.GetWidth()) * channels;
+  std::vector<std::uint8_t> pixels(row_bytes * height);
+  ForEachRowBand(height, GetRowBandNum(height, pixels.size(), pool), pool,
+                 [&](int, int begin, int end) {
+                   for (int y = begin; y < end; ++y) {
+                     ConvertRow(image, y, channels,
+                                pixels.data() + y * row_bytes);
+                   }
+                 });
+  return pixels;
+}
+
+void PutBigEndian32(std::uint32_t value, std::uint8_t* dst) {
+  dst[0] = value >> 24;
+  dst[1] = value >> 16 & 0xFF;
+  dst[2] = value >> 8 & 0xFF;
+  dst[3] = value & 0xFF;
+}
+
+std::uint32_t Load32(const std::uint8_t* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint64_t Load64(const std::uint8_t* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// CRC-32(PNG使用的多项式0xEDB88320)，每次查8张表处理8个字节
+class Crc32Table {
+ public:
+  Crc32Table() {
+    for (std::uint32_t n = 0; n < 256; ++n) {
+      std::uint32_t c = n;
+      for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table_[0][n] = c;
+    }
+    for (int k = 1; k < 8; ++k) {
+      for (int n = 0; n < 256; ++n) {
+        std::uint32_t c = table_[k - 1][n];
+        table_[k][n] = (c >> 8) ^ table_[0][c & 0xFF];
+      }
+    }
+  }
+
+  // @param crc 之前数据的CRC，从头开始时为0
+  std::uint32_t Update(std::uint32_t crc, const std::uint8_t* data,
+                       std::size_t size) const {
+    std::uint32_t c = ~crc;
+    for (; size >= 8; data += 8, size -= 8) {
+      std::uint32_t one = Load32(data) ^ c;
+      std::uint32_t two = Load32(data + 4);
+      c = table_[7][one & 0xFF] ^ table_[6][one >> 8 & 0xFF] ^
+          table_[5][one >> 16 & 0xFF] ^ table_[4][one >> 24] ^
+          table_[3][two & 0xFF] ^ table_[2][two >> 8 & 0xFF] ^
+          table_[1][two >> 16 & 0xFF] ^ table_[0][two >> 24];
+    }
+    for (; size; ++data, --size) c = table_[0][(c ^ *data) & 0xFF] ^ (c >> 8);
+    return ~c;
+  }
+
+ private:
+  std::uint32_t table_[8][256];
+};
+
+std::uint32_t Crc32(std::uint32_t crc, const std::uint8_t* data,
+                    std::size_t size) {
+  static const Crc32Table kTable;
+  return kTable.Update(crc, data, size);
+}
+
+const std::uint32_t kAdlerBase = 65521;
+// 32位累加不溢出时最多可以连续处理的字节数
+const std::size_t kAdlerBlock = 5552;
+
+// @param adler 之前数据的校验和，从头开始时为1
+std::uint32_t Adler32(std::uint32_t adler, const std::uint8_t* data,
+                      std::size_t size) {
+  std::uint32_t a = adler & 0xFFFF;
+  std::uint32_t b = adler >> 16;
+  while (size) {
+    std::size_t n = std::min(size, kAdlerBlock);
+    size -= n;
+    for (; n; --n) {
+      a += *data++;
+      b += a;
+    }
+    a %= kAdlerBase;
+    b %= kAdlerBase;
+  }
+  return a | b << 16;
+}
+
+// 由前后两段数据各自的校验和得到整体的校验和
+// @param size2 第二段数据的长度
+std::uint32_t Adler32Combine(std::uint32_t adler1, std::uint32_t adler2,
+                             std::size_t size2) {
+  std::uint32_t rem = size2 % kAdlerBase;
+  std::uint32_t a1 = adler1 & 0xFFFF;
+  std::uint32_t a = (a1 + (adler2 & 0xFFFF) + kAdlerBase - 1) % kAdlerBase;
+  std::uint32_t b = (static_cast<std::uint64_t>(rem) * a1 +
+                     (adler1 >> 16) + (adler2 >> 16) + kAdlerBase - rem) %
+                    kAdlerBase;
+  return a | b << 16;
+}
+
+// 按deflate的位序(低位在前)输出
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<std::uint8_t>* out) : out_(out) {}
+  // @param count 不超过32
+  void Write(std::uint32_t value, int count) {
+    bits_ |= static_cast<std::uint64_t>(value) << count_;
+    count_ += count;
+    if (32 <= count_) {
+      std::uint8_t bytes[4];
+      std::memcpy(bytes, &bits_, sizeof(bytes));
+      out_->insert(out_->end(), bytes, bytes + sizeof(bytes));
+      bits_ >>= 32;
+      count_ -= 32;
+    }
+  }
+  // 剩余的位补0到字节边界后全部输出
+  void Flush() {
+    for (; 0 < count_; count_ -= 8, bits_ >>= 8) {
+      out_->push_back(bits_ & 0xFF);
+    }
+    bits_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  std::vector<std::uint8_t>* out_;
+  std::uint64_t bits_ = 0;
+  int count_ = 0;
+};
+
+// 固定哈夫曼编码(RFC 1951 3.2.6)，码字已按输出位序反转
+class FixedHuffman {
+ public:
+  FixedHuffman() {
+    for (int symbol = 0; symbol < 288; ++symbol) {
+      int code = 0;
+      int length = 0;
+      if (144 > symbol) {
+        code = 0x30 + symbol;
+        length = 8;
+      } else if (256 > symbol) {
+        code = 0x190 + symbol - 144;
+        length = 9;
+      } else if (280 > symbol) {
+        code = symbol - 256;
+        length = 7;
+      } else {
+        code = 0xC0 + symbol - 280;
+        length = 8;
+      }
+      literal_code_[symbol] = Reverse(code, length);
+      literal_length_[symbol] = length;
+    }
+    for (int symbol = 0; symbol < 30; ++symbol) {
+      distance_code_[symbol] = Reverse(symbol, 5);
+    }
+  }
+
+  void WriteLiteral(int symbol, BitWriter* writer) const {
+    writer->Write(literal_code_[symbol], literal_length_[symbol]);
+  }
+  // @param length 匹配长度，[3,258]
+  // @param distance 匹配距离，[1,32768]
+  void WriteMatch(int length, int distance, BitWriter* writer) const {
+    int symbol = 285;
+    int extra_bits = 0;
+    int extra = 0;
+    int n = length - 3;
+    if (258 == length) {
+    } else if (8 > n) {
+      symbol = 257 + n;
+    } else {
+      int high = 31 - __builtin_clz(n);
+      symbol = 257 + 4 * (high - 1) + (n >> (high - 2) & 3);
+      extra_bits = high - 2;
+      extra = n & ((1 << extra_bits) - 1);
+    }
+    writer->Write(literal_code_[symbol] | extra << literal_length_[symbol],
+                  literal_length_[symbol] + extra_bits);
+    n = distance - 1;
+    if (4 > n) {
+      writer->Write(distance_code_[n], 5);
+      return;
+    }
+    int high = 31 - __builtin_clz(n);
+    symbol = 2 * high + (n >> (high - 1) & 1);
+    extra_bits = high - 1;
+    extra = n & ((1 << extra_bits) - 1);
+    writer->Write(distance_code_[symbol] | extra << 5, 5 + extra_bits);
+  }
+
+ private:
+  static int Reverse(int code, int length) {
+    int reversed = 0;
+    for (int i = 0; i < length; ++i) {
+      reversed |= (code >> i & 1) << (length - 1 - i);
+    }
+    return reversed;
+  }
+
+  std::uint16_t literal_code_[288];
+  std::uint8_t literal_length_[288];
+  std::uint8_t distance_code_[30];
+};
+
+const int kMinMatch = 4;
+const int kMaxMatch = 258;
+const int kWindowSize = 1 << 15;
+const int kHashBits = 15;
+
+// a与b开始的最长公共前缀，不超过max_length
+int MatchLength(const std::uint8_t* a, const std::uint8_t* b, int max_length) {
+  int length = 0;
+  for (; length + 8 <= max_length; length += 8) {
+    std::uint64_t diff = Load64(a + length) ^ Load64(b + length);
+    if (diff) return length + (__builtin_ctzll(diff) >> 3);
+  }
+  while (length < max_length && a[length] == b[length]) ++length;
+  return length;
+}
+
+// 用一个固定哈夫曼块压缩data，块不是最后一块
+// @param max_chain 每个位置最多比较的候选匹配数，为1时只在匹配的起点
+//   更新哈希表
+void DeflateFixed(const std::uint8_t* data, std::size_t size, int max_chain,
+                  BitWriter* writer) {
+  static const FixedHuffman kHuffman;
+  // BFINAL=0，BTYPE=01
+  writer->Write(2, 3);
+  std::vector<std::int32_t> head(1 << kHashBits, -1);
+  std::vector<std::int32_t> prev;
+  if (1 < max_chain) prev.resize(kWindowSize, -1);
+  auto hash = [](std::uint32_t value) {
+    return value * 2654435761u >> (32 - kHashBits);
+  };
+  auto insert = [&head, &prev, &hash, data](std::int32_t position) {
+    std::uint32_t h = hash(Load32(data + position));
+    prev[position & (kWindowSize - 1)] = head[h];
+    head[h] = position;
+  };
+  std::int32_t end = static_cast<std::int32_t>(size);
+  std::int32_t i = 0;
+  while (i + kMinMatch <= end) {
+    std::uint32_t value = Load32(data + i);
+    std::uint32_t h = hash(value);
+    int max_length = std::min(kMaxMatch, end - i);
+    int best_length = 0;
+    int best_distance = 0;
+    std::int32_t candidate = head[h];
+    for (int chain = max_chain; 0 < chain && 0 <= candidate &&
+                                i - candidate <= kWindowSize;
+         --chain) {
+      if (Load32(data + candidate) == value) {
+        int length = MatchLength(data + candidate, data + i, max_length);
+        if (length > best_length) {
+          best_length = length;
+          best_distance = i - candidate;
+          if (length == max_length) break;
+        }
+      }
+      if (prev.empty()) break;
+      std::int32_t next = prev[candidate & (kWindowSize - 1)];
+      // 环形数组中的项已被更新的位置覆盖
+      if (next >= candidate) break;
+      candidate = next;
+    }
+    if (prev.empty()) {
+      head[h] = i;
+    } else {
+      insert(i);
+    }
+    if (kMinMatch <= best_length) {
+      kHuffman.WriteMatch(best_length, best_distance, writer);
+      if (!prev.empty()) {
+        std::int32_t last = std::min(i + best_length, end - kMinMatch + 1);
+        for (std::int32_t k = i + 1; k < last; ++k) insert(k);
+      }
+      i += best_length;
+    } else {
+      kHuffman.WriteLiteral(data[i], writer);
+      ++i;
+    }
+  }
+  for (; i < end; ++i) kHuffman.WriteLiteral(data[i], writer);
+  kHuffman.WriteLiteral(256, writer);
+}
+
+// 以不压缩的存储块输出data，块不是最后一块
+void DeflateStored(const std::uint8_t* data, std::size_t size,
+                   std::vector<std::uint8_t>* out) {
+  const std::size_t kMaxBlock = 0xFFFF;
+  for (std::size_t offset = 0; offset < size; offset += kMaxBlock) {
+    std::size_t length = std::min(kMaxBlock, size - offset);
+    std::uint8_t header[5] = {0, static_cast<std::uint8_t>(length & 0xFF),
+                              static_cast<std::uint8_t>(length >> 8),
+                              static_cast<std::uint8_t>(~length & 0xFF),
+                              static_cast<std::uint8_t>(~length >> 8 & 0xFF)};
+    out->insert(out->end(), header, header + sizeof(header));
+    out->insert(out->end(), data + offset, data + offset + length);
+  }
+}
+
+// 写成两次选择而不是分支，滤波结果难以预测时不会频繁分支预测失败
+std::uint8_t Paeth(int a, int b, int c) {
+  int pa = std::abs(b - c);
+  int pb = std::abs(a - c);
+  int pc = std::abs(a + b - 2 * c);
+  int nearest = pb <= pc ? b : c;
+  return pa <= pb && pa <= pc ? a : nearest;
+}
+
+// PNG的行滤波类型
+enum FilterType {
+  kFilterNone = 0,
+  kFilterSub = 1,
+  kFilterUp = 2,
+  kFilterAverage = 3,
+  kFilterPaeth = 4,
+};
+
+// 滤波后各字节(视为有符号数)的绝对值之和，越小通常越容易压缩
+std::uint32_t GetFilterCost(const std::uint8_t* filtered,
+                            std::size_t row_bytes) {
+  std::uint32_t sum = 0;
+  std::size_t i = 0;
+#ifdef __SSE2__
+  // 按无符号数min(x, -x)即有符号数的绝对值，再用psadbw求和
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+  for (; i + 16 <= row_bytes; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(filtered + i));
+    __m128i abs = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(abs, zero));
+  }
+  sum = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+  for (; i < row_bytes; ++i) {
+    sum += std::abs(static_cast<std::int8_t>(filtered[i]));
+  }
+  return sum;
+}
+
+// 用一种滤波处理一行，写入dst
+void ApplyFilter(FilterType type, const std::uint8_t* row,
+                 const std::uint8_t* prev, std::size_t row_bytes, int bpp,
+                 std::uint8_t* dst) {
+  // 行首bpp个字节的左侧与左上邻居为0，单独处理
+  std::size_t head = std::min<std::size_t>(bpp, row_bytes);
+  // 以下各循环从i开始，前面的部分已由SIMD处理
+  std::size_t i = 0;
+#ifdef __SSE2__
+  auto load = [](const std::uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  };
+  auto store = [dst](std::size_t i, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+  };
+#endif
+  switch (type) {
+    case kFilterNone:
+      std::memcpy(dst, row, row_bytes);
+      break;
+    case kFilterSub:
+      std::memcpy(dst, row, head);
+      i = head;
+#ifdef __SSE2__
+      for (; i + 16 <= row_bytes; i += 16) {
+        store(i, _mm_sub_epi8(load(row + i), load(row + i - bpp)));
+      }
+#endif
+      for (; i < row_bytes; ++i) dst[i] = row[i] - row[i - bpp];
+      break;
+    case kFilterUp:
+#ifdef __SSE2__
+      for (; i + 16 <= row_bytes; i += 16) {
+        store(i, _mm_sub_epi8(load(row + i), load(prev + i)));
+      }
+#endif
+      for (; i < row_bytes; ++i) dst[i] = row[i] - prev[i];
+      break;
+    case kFilterAverage:
+      for (; i < head; ++i) dst[i] = row[i] - (prev[i] >> 1);
+#ifdef __SSE2__
+      for (; i + 16 <= row_bytes; i += 16) {
+        // pavgb向上取整，和为奇数时减1得到向下取整的平均值
+        __m128i a = load(row + i - bpp);
+        __m128i b = load(prev + i);
+        __m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+        __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+        store(i, _mm_sub_epi8(load(row + i), average));
+      }
+#endif
+      for (; i < row_bytes; ++i) {
+        dst[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+      }
+      break;
+    case kFilterPaeth:
+      // 左侧与左上都为0时Paeth预测值就是上方的值
+      for (; i < head; ++i) dst[i] = row[i] - prev[i];
+#ifdef __SSE2__
+      // 每次8个字节，扩展到16位计算三个距离后按掩码选择预测值
+      for (; i + 8 <= row_bytes; i += 8) {
+        const __m128i zero = _mm_setzero_si128();
+        auto load8 = [zero](const std::uint8_t* p) {
+          return _mm_unpacklo_epi8(
+              _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+        };
+        auto abs16 = [zero](__m128i v) {
+          return _mm_max_epi16(v, _mm_sub_epi16(zero, v));
+        };
+        __m128i a = load8(row + i - bpp);
+        __m128i b = load8(prev + i);
+        __m128i c = load8(prev + i - bpp);
+        __m128i bc = _mm_sub_epi16(b, c);
+        __m128i ac = _mm_sub_epi16(a, c);
+        __m128i pa = abs16(bc);
+        __m128i pb = abs16(ac);
+        __m128i pc = abs16(_mm_add_epi16(bc, ac));
+        // 与标量版本相同：pa最小时取a，否则pb <= pc时取b
+        __m128i not_a =
+            _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+        __m128i nearest = _mm_or_si128(_mm_andnot_si128(not_b, b),
+                                       _mm_and_si128(not_b, c));
+        __m128i predictor = _mm_or_si128(_mm_andnot_si128(not_a, a),
+                                         _mm_and_si128(not_a, nearest));
+        __m128i current =
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i));
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i*>(dst + i),
+            _mm_sub_epi8(current, _mm_packus_epi16(predictor, zero)));
+      }
+#endif
+      for (; i < row_bytes; ++i) {
+        dst[i] = row[i] - Paeth(row[i - bpp], prev[i], prev[i - bpp]);
+      }
+      break;
+  }
+}
+
+// 依次尝试前filter_num种滤波，选出GetFilterCost最小的一种，
+// 写入out: 滤波类型字节加滤波后的行
+// @param prev 上一行，第一行时为全0
+// @param scratch 至少2 * row_bytes字节
+void FilterRow(const std::uint8_t* row, const std::uint8_t* prev,
+               std::size_t row_bytes, int bpp, int filter_num,
+               std::uint8_t* scratch, std::uint8_t* out) {
+  // 不滤波时直接用原始行计算代价，best与candidate在scratch的两半之间
+  // 交替，较好的结果不必复制
+  const std::uint8_t* best = row;
+  std::uint8_t* candidate = scratch;
+  std::uint8_t* spare = scratch + row_bytes;
+  out[0] = kFilterNone;
+  std::uint32_t best_cost = GetFilterCost(row, row_bytes);
+  for (int type = kFilterSub; type < filter_num; ++type) {
+    ApplyFilter(static_cast<FilterType>(type), row, prev, row_bytes, bpp,
+                candidate);
+    std::uint32_t cost = GetFilterCost(candidate, row_bytes);
+    if (cost < best_cost) {
+      best_cost = cost;
+      out[0] = type;
+      best = candidate;
+      std::swap(candidate, spare);
+    }
+  }
+  std::memcpy(out + 1, best, row_bytes);
+}
+
+// 在out末尾加上完整的PNG块：长度、类型、数据、CRC
+void AppendChunk(const char* type, const std::uint8_t* data, std::size_t size,
+                 std::vector<std::uint8_t>* out) {
+  std::size_t begin = out->size();
+  out->resize(begin + 8 + size + 4);
+  std::uint8_t* chunk = out->data() + begin;
+  PutBigEndian32(static_cast<std::uint32_t>(size), chunk);
+  std::memcpy(chunk + 4, type, 4);
+  if (size) std::memcpy(chunk + 8, data, size);
+  PutBigEndian32(Crc32(0, chunk + 4, 4 + size), chunk + 8 + size);
+}
+}  // namespace
+
+std::string TgaEncoder::GetExtension() const { return "tga"; }
+
+bool TgaEncoder::Write(const TgaImage& image, const std::string& filename,
+                       ThreadPool* pool) const {
+  return image.WriteTgaFile(filename, false, false, rle_, pool);
+}
+
+std::string RawEncoder::GetExtension() const { return "rgba"; }
+
+bool RawEncoder::Write(const TgaImage& image, const std::string& filename,
+                       ThreadPool* pool) const {
+  if (!CheckImage(image)) return false;
+  std::vector<std::uint8_t> pixels = ConvertImage(image, 4, pool);
+  std::vector<iovec> iov{iovec{pixels.data(), pixels.size()}};
+  return WriteFile(filename, &iov);
+}
+
+std::string PpmEncoder::GetExtension() const { return "ppm"; }
+
+bool PpmEncoder::Write(const TgaImage& image, const std::string& filename,
+                       ThreadPool* pool) const {
+  if (!CheckImage(image)) return false;
+  bool gray = TgaImage::kGrayscale == image.GetBytespp();
+  std::string header = std::string(gray ? "P5\n" : "P6\n") +
+                       std::to_string(image.GetWidth()) + " " +
+                       std::to_string(image.GetHeight()) + "\n255\n";
+  std::vector<std::uint8_t> pixels = ConvertImage(image, gray ? 1 : 3, pool);
+  std::vector<iovec> iov{iovec{&header[0], header.size()},
+                         iovec{pixels.data(), pixels.size()}};
+  return WriteFile(filename, &iov);
+}
+
+std::string PngEncoder::GetExtension() const { return "png"; }
+
+bool PngEncoder::Write(const TgaImage& image, const std::string& filename,
+                       ThreadPool* pool) const {
+  if (!CheckImage(image)) return false;
+  int width = image.GetWidth();
+  int height = image.GetHeight();
+  int channels = image.GetBytespp();
+  std::size_t row_bytes = static_cast<std::size_t>(width) * channels;
+
+  // 签名与IHDR块
+  std::vector<std::uint8_t> header{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                   '\n'};
+  std::uint8_t ihdr[13] = {};
+  PutBigEndian32(width, ihdr);
+  PutBigEndian32(height, ihdr + 4);
+  // 位深8，颜色类型：0灰度、2 RGB、6 RGBA，压缩、滤波、隔行方式均为0
+  ihdr[8] = 8;
+  ihdr[9] = TgaImage::kGrayscale == channels
+                ? 0
+                : (TgaImage::kRGB == channels ? 2 : 6);
+  AppendChunk("IHDR", ihdr, sizeof(ihdr), &header);
+
+  // 每个行带是一个完整的IDAT块，块头的长度在压缩后填写
+  int band_num =
+      GetRowBandNum(height, row_bytes * height, pool, kMinPngBandRows);
+  std::vector<std::vector<std::uint8_t>> bands(band_num);
+  std::vector<std::uint32_t> adlers(band_num);
+  std::vector<std::size_t> sizes(band_num);
+  ForEachRowBand(height, band_num, pool, [&](int band, int begin, int end) {
+    std::size_t filtered_row_bytes = 1 + row_bytes;
+    std::vector<std::uint8_t> filtered(filtered_row_bytes * (end - begin));
+    std::vector<std::uint8_t> row(row_bytes);
+    std::vector<std::uint8_t> prev(row_bytes, 0);
+    std::vector<std::uint8_t> scratch(2 * row_bytes);
+    if (0 < begin && kStored != level_) {
+      ConvertRow(image, begin - 1, channels, prev.data());
+    }
+    for (int y = begin; y < end; ++y) {
+      std::uint8_t* out = filtered.data() + (y - begin) * filtered_row_bytes;
+      ConvertRow(image, y, channels, row.data());
+      if (kStored == level_) {
+        out[0] = 0;
+        std::memcpy(out + 1, row.data(), row_bytes);
+      } else {
+        FilterRow(row.data(), prev.data(), row_bytes, channels,
+                  kFast == level_ ? kFilterAverage : kFilterPaeth + 1,
+                  scratch.data(), out);
+        row.swap(prev);
+      }
+    }
+    adlers[band] = Adler32(1, filtered.data(), filtered.size());
+    sizes[band] = filtered.size();
+
+    std::vector<std::uint8_t>& chunk = bands[band];
+    chunk.reserve(kStored == level_ ? filtered.size() + filtered.size() / 8 + 64
+                                    : filtered.size() / 4 + 64);
+    chunk.assign({0, 0, 0, 0, 'I', 'D', 'A', 'T'});
+    // zlib头：deflate，32K窗口，无预设字典
+    if (0 == band) chunk.insert(chunk.end(), {0x78, 0x01});
+    // 行带以一个空存储块结束，之后的数据从字节边界开始；
+    // 最后一个行带的空存储块同时是整个数据流的最后一块
+    std::uint8_t last = band_num - 1 == band ? 1 : 0;
+    if (kStored == level_) {
+      DeflateStored(filtered.data(), filtered.size(), &chunk);
+      chunk.push_back(last);
+    } else {
+      BitWriter writer(&chunk);
+      DeflateFixed(filtered.data(), filtered.size(), kFast == level_ ? 1 : 32,
+                   &writer);
+      writer.Write(last, 3);
+      writer.Flush();
+    }
+    chunk.insert(chunk.end(), {0, 0, 0xFF, 0xFF});
+    std::size_t size = chunk.size() - 8;
+    PutBigEndian32(static_cast<std::uint32_t>(size), chunk.data());
+    std::uint8_t crc[4];
+    PutBigEndian32(Crc32(0, chunk.data() + 4, 4 + size), crc);
+    chunk.insert(chunk.end(), crc, crc + sizeof(crc));
+  });
+
+  // adler32跟在最后一个行带之后，单独作为一个IDAT块
+  std::uint32_t adler = adlers[0];
+  for (int band = 1; band < band_num; ++band) {
+    adler = Adler32Combine(adler, adlers[band], sizes[band]);
+  }
+  std::uint8_t adler_bytes[4];
+  PutBigEndian32(adler, adler_bytes);
+  std::vector<std::uint8_t> trailer;
+  AppendChunk("IDAT", adler_bytes, sizeof(adler_bytes), &trailer);
+  AppendChunk("IEND", nullptr, 0, &trailer);
+
+  std::vector<iovec> iov;
+  iov.push_back(iovec{header.data(), header.size()});
+  for (std::vector<std::uint8_t>& band : bands) {
+    iov.push_back(iovec{band.data(), band.size()});
+  }
+  iov.push_back(iovec{trailer.data(), trailer.size()});
+  return WriteFile(filename, &iov);
+}
@@ -0,0 +1,220 @@
+#include "include/indexed_mesh.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "include/geometry.h"
+#include "include/model.h"
+
+namespace {
+// 去重表中的一项：同一几何顶点的不同(vt, vn)组合串成链表
+struct CornerEntry {
+  int texture;
+  int normal;
+  std::uint32_t index;
+  int next;
+};
+
+// Forsyth算法的顶点评分：刚用过的顶点得分高(最近一个三角形的3个顶点
+// 固定为0.75，避免立即重用同一条边)，剩余三角形少的顶点得分高，
+// 使孤立的三角形尽早处理掉。两部分都预先制成表，避免内循环中的pow/sqrt。
+class VertexScorer {
+ public:
+  explicit VertexScorer(int cache_size) : cache_score_(cache_size) {
+    for (int i = 0; i < cache_size; ++i) {
+      cache_score_[i] =
+          3 > i ? .75f
+                : std::pow(1.f - (i - 3) / static_cast<float>(cache_size - 3),
+                           1.5f);
+    }
+    for (int i = 1; i < kValenceTableSize; ++i) {
+      valence_score_[i] = 2.f / std::sqrt(static_cast<float>(i));
+    }
+  }
+
+  // @param cache_position 在模拟LRU缓存中的位置，不在缓存中为-1
+  // @param remaining 尚未输出的相邻三角形数
+  float Score(int cache_position, int remaining) const {
+    if (0 == remaining) return -1.f;
+    float score = 0 <= cache_position ? cache_score_[cache_position] : 0;
+    return score + (remaining < kValenceTableSize
+                        ? valence_score_[remaining]
+                        : 2.f / std::sqrt(static_cast<float>(remaining)));
+  }
+
+ private:
+  static constexpr int kValenceTableSize = 32;
+
+  std::vector<float> cache_score_;
+  float valence_score_[kValenceTableSize] = {};
+};
+}  // namespace
+
+IndexedMesh::IndexedMesh(const ObjModel& model) {
+  int face_num = static_cast<int>(model.GetFaceNum());
+  // 以几何顶点下标为桶，桶内的(vt, vn)组合通常只有一两个，
+  // 比通用哈希表少一次散列且访问更集中
+  std::vector<int> heads(model.GetVertexNum(), -1);
+  std::vector<CornerEntry> entries;
+  entries.reserve(model.GetVertexNum());
+  vertices_.reserve(model.GetVertexNum());
+  indices_.reserve(3 * static_cast<std::size_t>(face_num));
+  for (int i = 0; i < face_num; ++i) {
+    Vector3Int face = model.GetFaceVertices(i);
+    Vector3Int face_texture = model.GetFaceVertexTextures(i);
+    Vector3Int face_normal = model.GetFaceVertexNormals(i);
+    for (int k = 0; k < 3; ++k) {
+      int e = heads[face[k]];
+      while (0 <= e && (entries[e].texture != face_texture[k] ||
+                        entries[e].normal != face_normal[k])) {
+        e = entries[e].next;
+      }
+      if (0 > e) {
+        e = static_cast<int>(entries.size());
+        entries.push_back(CornerEntry{
+            face_texture[k], face_normal[k],
+            static_cast<std::uint32_t>(vertices_.size()), heads[face[k]]});
+        heads[face[k]] = e;
+        Vector3 position = model.GetVertex(face[k]);
+        Vector2 texture = model.GetTexture(face_texture[k]);
+        Vector3 normal = model.GetNormal(face_normal[k]);
+        vertices_.push_back(MeshVertex{
+            {position[0], position[1], position[2]},
+            {texture[0], texture[1]},
+            {normal[0], normal[1], normal[2]}});
+      }
+      indices_.push_back(entries[e].index);
+    }
+  }
+}
+
+IndexedMesh::~IndexedMesh() = default;
+
+void IndexedMesh::OptimizeVertexCache() {
+  int vertex_num = GetVertexNum();
+  int triangle_num = GetTriangleNum();
+  if (0 == triangle_num) return;
+
+  // 每个顶点相邻的三角形，CSR形式：
+  // adjacency[offsets[v], offsets[v] + remaining[v])为尚未输出的三角形
+  std::vector<int> offsets(vertex_num + 1, 0);
+  for (std::uint32_t index : indices_) ++offsets[index + 1];
+  for (int v = 0; v < vertex_num; ++v) offsets[v + 1] += offsets[v];
+  std::vector<int> remaining(vertex_num, 0);
+  std::vector<int> adjacency(indices_.size());
+  for (int t = 0; t < triangle_num; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      int v = indices_[3 * t + k];
+      adjacency[offsets[v] + remaining[v]++] = t;
+    }
+  }
+
+  VertexScorer scorer(kCacheSize);
+  std::vector<int> cache_position(vertex_num, -1);
+  std::vector<float> vertex_score(vertex_num);
+  for (int v = 0; v < vertex_num; ++v) {
+    vertex_score[v] = scorer.Score(-1, remaining[v]);
+  }
+  std::vector<float> triangle_score(triangle_num);
+  std::vector<bool> emitted(triangle_num, false);
+  int best = 0;
+  for (int t = 0; t < triangle_num; ++t) {
+    triangle_score[t] = vertex_score[indices_[3 * t]] +
+                        vertex_score[indices_[3 * t + 1]] +
+                        vertex_score[indices_[3 * t + 2]];
+    if (triangle_score[t] > triangle_score[best]) best = t;
+  }
+
+  // 缓存中多留3个位置给新加入的顶点，超出kCacheSize的部分即被淘汰
+  std::vector<int> cache;
+  std::vector<int> next_cache;
+  cache.reserve(kCacheSize + 3);
+  next_cache.reserve(kCacheSize + 3);
+  std::vector<std::uint32_t> order;
+  order.reserve(indices_.size());
+  // 缓存中的顶点没有剩余三角形时，按原顺序取下一个未输出的三角形
+  int cursor = 0;
+  for (int n = 0; n < triangle_num; ++n) {
+    if (0 > best) {
+      while (emitted[cursor]) ++cursor;
+      best = cursor;
+    }
+    emitted[best] = true;
+    const std::uint32_t* tri = &indices_[3 * static_cast<std::size_t>(best)];
+    next_cache.assign(tri, tri + 3);
+    for (int k = 0; k < 3; ++k) {
+      int v = tri[k];
+      order.push_back(v);
+      // 把该三角形从顶点的剩余列表中移除
+      int* begin = &adjacency[offsets[v]];
+      int* end = begin + remaining[v];
+      for (int* p = begin; p < end; ++p) {
+        if (best == *p) {
+          *p = *(end - 1);
+          break;
+        }
+      }
+      --remaining[v];
+    }
+    for (int v : cache) {
+      if (v != static_cast<int>(tri[0]) && v != static_cast<int>(tri[1]) &&
+          v != static_cast<int>(tri[2])) {
+        next_cache.push_back(v);
+      }
+    }
+    cache.swap(next_cache);
+
+    // 只有缓存中(以及刚被淘汰)的顶点得分发生变化
+    for (int i = 0; i < static_cast<int>(cache.size()); ++i) {
+      int v = cache[i];
+      cache_position[v] = i < kCacheSize ? i : -1;
+      vertex_score[v] = scorer.Score(cache_position[v], remaining[v]);
+    }
+    best = -1;
+    float best_score = -1.f;
+    for (int v : cache) {
+      for (int i = offsets[v]; i < offsets[v] + remaining[v]; ++i) {
+        int t = adjacency[i];
+        triangle_score[t] = vertex_score[indices_[3 * t]] +
+                            vertex_score[indices_[3 * t + 1]] +
+                            vertex_score[indices_[3 * t + 2]];
+        if (triangle_score[t] > best_score) {
+          best_score = triangle_score[t];
+          best = t;
+        }
+      }
+    }
+    if (static_cast<int>(cache.size()) > kCacheSize) cache.resize(kCacheSize);
+  }
+
+  // 顶点按首次使用的顺序重新编号
+  std::vector<int> remap(vertex_num, -1);
+  std::vector<MeshVertex> vertices;
+  vertices.reserve(vertex_num);
+  for (std::uint32_t& index : order) {
+    if (0 > remap[index]) {
+      remap[index] = static_cast<int>(vertices.size());
+      vertices.push_back(vertices_[index]);
+    }
+    index = remap[index];
+  }
+  vertices_.swap(vertices);
+  indices_.swap(order);
+}
+
+double IndexedMesh::ComputeAcmr(int cache_size) const {
+  int triangle_num = GetTriangleNum();
+  if (0 == triangle_num) return 0;
+  // FIFO缓存：顶点进入缓存时的未命中计数，计数已前进cache_size次即被淘汰
+  std::vector<long long> stamp(vertices_.size(), -1);
+  long long misses = 0;
+  for (std::uint32_t index : indices_) {
+    if (0 > stamp[index] || misses - stamp[index] >= cache_size) {
+      stamp[index] = misses;
+      ++misses;
+    }
+  }
+  return static_cast<double>(misses) / triangle_num;
+}
@@ -1,12 +1,37 @@
+#include <algorithm>
 #include <array>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "include/batch_renderer.h"
+#include "include/depth_buffer.h"
+#include "include/framebuffer.h"
 #include "include/geometry.h"
+#include "include/image_encoder.h"
+#include "include/indexed_mesh.h"
+#include "include/mapped_file.h"
+#include "include/mesh_stream.h"
 #include "include/model.h"
+#include "include/primitive_assembler.h"
+#include "include/profiler.h"
+#include "include/rasterizer.h"
 #include "include/shader.h"
+#include "include/texture.h"
 #include "include/tga_image.h"
+#include "include/thread_pool.h"
+#include "include/transform.h"
+#include "include/vertex_stage.h"
 
 // draw line use Bresenham's algs
 // 每单位x增长的dy正是k的值，k =
@@ -83,45 +108,103 @@ void TriangleByLineSwap(int x0, int y0, int x1, int y1, int x2, int y2,
   }
 }
 
-void Rasterization(const std::array<Vector4, 3>& v,
-                   std::vector<double>& zbuffer, const double width,
-                   IShader* shader) {
-  // use BB
-  // optimization possible?
-  double xmin = std::floor(std::min(v[0][0], std::min(v[1][0], v[2][0])));
-  double xmax = std::ceil(std::max(v[0][0], std::max(v[1][0], v[2][0])));
-  double ymin = std::floor(std::min(v[0][1], std::min(v[1][1], v[2][1])));
-  double ymax = std::ceil(std::max(v[0][1], std::max(v[1][1], v[2][1])));
+// 流式渲染时每个面在渲染端占用的字节数的估计：
+// 裁剪空间坐标以及光栅化器中等待Flush的三角形与建立结果
+const std::size_t kRenderBytesPerFace = 512;
 
-  // check three vertices at one line
-  // 123 abc
-  Vector4 ab = v[1] - v[0];
-  Vector4 bc = v[2] - v[1];
-  if (1e-6 > vector_m::Cross(ab, bc).Norm()) {
-    return;
-  }
-
-  for (int i = xmin; i <= xmax; ++i) {
-    for (int j = ymin; j <= ymax; ++j) {
-      double ap_x = i * 1. - v[0][0];
-      double ap_y = j * 1. - v[0][1];
-      Vector3 x_component{ab[0], bc[0], ap_x};
-      Vector3 y_component{ab[1], bc[1], ap_y};
-      Vector3 product = vector_m::Cross(x_component, y_component);
-      product = product / (-product[2]);
-      if (1 >= product[0] && 0 <= product[1] && product[0] >= product[1]) {
-        Vector3 barycentric{1. - product[0], product[0] - product[1],
-                            product[1]};
-        double interpo_z =
-            vector_m::Dot(barycentric, Vector3{v[0][2], v[1][2], v[2][2]});
-        int pixel_index = j * width + i;
-        if (interpo_z > zbuffer[pixel_index]) {
-          zbuffer[pixel_index] = interpo_z;
-          shader->fragment_process(Vector2Int{i, j}, barycentric);
+// 以流式方式渲染网格缓存中的模型，常驻内存约为memory_budget，与模型大小无关。
+// 每个分段的面变换、装配后立即光栅化，深度缓冲跨分段保留，
+// 结果与整体渲染相同。
+void RenderStreaming(const std::string& cache_filename,
+                     std::size_t memory_budget, TextureShader* shader,
+                     PrimitiveAssembler* assembler, Rasterizer* rasterizer) {
+  // 一半用于分段与渲染端，一半作为顶点与纹理坐标的驻留预算
+  std::size_t vertex_budget = memory_budget / 2;
+  std::size_t face_budget =
+      (memory_budget - vertex_budget) /
+      (MeshStream::kChunkNum * MeshStream::kBytesPerFace +
+       kRenderBytesPerFace);
+  int chunk_face_num = static_cast<int>(
+      std::min<std::size_t>(face_budget, std::numeric_limits<int>::max() / 3));
+  MeshStream stream(cache_filename, chunk_face_num, vertex_budget);
+  if (!stream.IsOpen()) return;
+  chunk_face_num = stream.GetChunkFaceNum();
+  SMatrix4 mvp = shader->GetMvp();
+  std::vector<double> clip[4];
+  for (auto& c : clip) c.resize(3 * static_cast<std::size_t>(chunk_face_num));
+  double* const out[4] = {clip[0].data(), clip[1].data(), clip[2].data(),
+                          clip[3].data()};
+  Triangle triangle;
+  while (const MeshStream::Chunk* chunk = stream.Acquire()) {
+    int corner_num = 3 * chunk->face_num;
+    {
+      ScopedTimer timer(Profiler::kVertexProcessing, 0);
+      transform_m::Transform(
+          mvp,
+          transform_m::ConstPointSpan{chunk->x.data(), chunk->y.data(),
+                                      chunk->z.data(), nullptr},
+          corner_num, transform_m::PointSpan{out[0], out[1], out[2], out[3]},
+          &ThreadPool::Global());
+    }
+    {
+      ScopedTimer timer(Profiler::kPrimitiveAssembly, 0);
+      for (int i = 0; i < corner_num; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+          triangle.vertices[k] = Vector4{out[0][i + k], out[1][i + k],
+                                         out[2][i + k], out[3][i + k]};
+          triangle.texture_coordinates[k] =
+              Vector2{chunk->u[i + k], chunk->v[i + k]};
         }
+        assembler->Assemble(triangle, rasterizer);
       }
     }
+    stream.Release(chunk);
+    ScopedTimer timer(Profiler::kRasterization, 0);
+    rasterizer->Flush(shader);
+  }
+}
+
+// 批量渲染所有相机并输出吞吐量，网格与纹理只加载一次
+void RenderBatch(const IndexedMesh& mesh, const std::string& texture_filename,
+                 const std::vector<Camera>& cameras,
+                 const std::string& filename_prefix,
+                 const ImageEncoder* encoder, int width, int height) {
+  Texture texture;
+  {
+    ScopedTimer timer(Profiler::kTextureLoad, Profiler::kSetupFrame);
+    texture = LoadTexture(texture_filename, &ThreadPool::Global());
+  }
+  BatchRenderer renderer(&mesh, &texture, width, height,
+                         &ThreadPool::Global());
+  renderer.SetEncoder(encoder);
+  BatchRenderer::Stats stats = renderer.Render(cameras, filename_prefix);
+  // 写文件时间中没有让渲染等待的部分即与渲染重叠的部分
+  double overlap = stats.writer.write_seconds - stats.writer.stall_seconds;
+  std::cerr << "frames: " << stats.frames << "/" << cameras.size()
+            << ", frame pool: " << renderer.GetFramePoolSize()
+            << ", seconds: " << stats.seconds
+            << ", frames/second: " << stats.frames / stats.seconds << ".\n"
+            << "render: " << stats.render_seconds
+            << " s, write: " << stats.writer.write_seconds
+            << " s, render stalled on write: " << stats.writer.stall_seconds
+            << " s, write overlapped with render: "
+            << (0 < stats.writer.write_seconds
+                    ? 100 * std::max(0., overlap) / stats.writer.write_seconds
+                    : 0)
+            << "%.\n";
+}
+
+// 文件名为空的输出不写
+bool WriteProfile(const std::string& profile_filename,
+                  const std::string& trace_filename) {
+  bool ok = true;
+  if (!profile_filename.empty()) {
+    ok = Profiler::Global().WriteJson(profile_filename) && ok;
   }
+  if (!trace_filename.empty()) {
+    ok = Profiler::Global().WriteChromeTrace(trace_filename) && ok;
+  }
+  return ok;
 }
 
 const int width = 800;
@@ -130,33 +213,254 @@ Vector3 camera_pos{-2, 0, 2};
 Vector3 gaze_dir{1, 0, -1};
 Vector3 up{0, 1, 0};
 
+const char kUsage[] =
+    "usage: renderer [--stream <memory budget in MiB>] [--optimize-mesh]\n"
+    "                [--fixed-point] [--depth-format float32|unorm24|unorm16]\n"
+    "                [--camera px,py,pz,gx,gy,gz,ux,uy,uz]... "
+    "[--cameras <file>]\n"
+    "                [--output-prefix <prefix>] [--rle]\n"
+    "                [--format tga|raw|ppm|png] "
+    "[--png-level stored|fast|small]\n"
+    "                [--profile <json file>] [--trace <trace file>]\n";
+
+// 解析以MiB为单位的内存预算
+// @return 不是正整数或换算为字节后溢出时返回false
+bool ParseMemoryBudget(const char* text, std::size_t* bytes) {
+  // strtoull接受前导空白与负号，负数会被转换为很大的正数
+  if (!std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+  errno = 0;
+  char* end = nullptr;
+  unsigned long long mebibytes = std::strtoull(text, &end, 10);
+  if (0 != errno || '\0' != *end || 0 == mebibytes ||
+      mebibytes > (SIZE_MAX >> 20)) {
+    return false;
+  }
+  *bytes = static_cast<std::size_t>(mebibytes) << 20;
+  return true;
+}
+
+// usage: renderer [--stream <memory budget in MiB>] [--optimize-mesh]
+//                 [--fixed-point] [--depth-format float32|unorm24|unorm16]
+//                 [--camera px,py,pz,gx,gy,gz,ux,uy,uz]... [--cameras <file>]
+//                 [--output-prefix <prefix>] [--rle]
+//                 [--format tga|raw|ppm|png] [--png-level stored|fast|small]
+//                 [--profile <json file>] [--trace <trace file>]
+// --stream 从网格缓存分段读取面并渲染，常驻内存约为给定的预算。
+//   缓存不存在或已过期时仍需先把整个.obj解析到内存中再写出缓存，
+//   这一次的内存占用与模型大小有关
+// --optimize-mesh 渲染前按顶点缓存局部性重排三角形，
+//   重排本身的开销只有在同一网格绘制多次时才能摊还
+// --fixed-point 光栅化使用定点坐标与整数覆盖测试，结果可逐位复现
+// --depth-format 深度缓冲的存储格式，默认float32
+// --camera/--cameras 给出相机时进入批量模式，每个相机渲染一帧，
+//   写入<prefix>0000.tga、<prefix>0001.tga...，prefix默认为frame-，
+//   扩展名随输出格式变化；
+//   批量模式使用浮点光栅化与float32深度缓冲，不能与--stream同时使用
+// --rle 输出RLE压缩的TGA
+// --format 输出格式，默认tga；raw为无文件头的RGBA像素(扩展名rgba)
+// --png-level PNG的压缩级别，默认fast
+// --profile 把各帧各阶段的耗时与三角形、像素计数写入文件，每帧一行JSON；
+//   加载模型与纹理记为第-1帧
+// --trace 把各阶段的执行区间写成Chrome trace格式
 int main(int argc, char const* argv[]) {
-  ObjModel* head = new ObjModel("/home/tea/my-renderer/obj/african_head.obj");
-  TgaImage* image = new TgaImage(width, height, TgaImage::kRGB);
-  TextureShader shader("/home/tea/my-renderer/obj/african_head_diffuse.tga");
-  shader.RegisterCanvas(image);
+  std::size_t stream_budget = 0;
+  bool optimize_mesh = false;
+  bool fixed_point = false;
+  DepthBuffer::Format depth_format = DepthBuffer::kFloat32;
+  std::vector<Camera> cameras;
+  std::string output_prefix = "frame-";
+  bool rle = false;
+  std::string format = "tga";
+  PngEncoder::Level png_level = PngEncoder::kFast;
+  std::string profile_filename;
+  std::string trace_filename;
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp("--stream", argv[i]) && i + 1 < argc) {
+      if (!ParseMemoryBudget(argv[++i], &stream_budget)) {
+        std::cerr << "Invalid memory budget " << argv[i] << ".\n" << kUsage;
+        return 1;
+      }
+    } else if (0 == std::strcmp("--optimize-mesh", argv[i])) {
+      optimize_mesh = true;
+    } else if (0 == std::strcmp("--fixed-point", argv[i])) {
+      fixed_point = true;
+    } else if (0 == std::strcmp("--depth-format", argv[i]) && i + 1 < argc) {
+      const char* format = argv[++i];
+      if (0 == std::strcmp("float32", format)) {
+        depth_format = DepthBuffer::kFloat32;
+      } else if (0 == std::strcmp("unorm24", format)) {
+        depth_format = DepthBuffer::kUnorm24;
+      } else if (0 == std::strcmp("unorm16", format)) {
+        depth_format = DepthBuffer::kUnorm16;
+      } else {
+        std::cerr << "Unknown depth format " << format << ".\n";
+        return 1;
+      }
+    } else if (0 == std::strcmp("--camera", argv[i]) && i + 1 < argc) {
+      Camera camera;
+      if (!ParseCamera(argv[++i], &camera)) {
+        std::cerr << "Invalid camera " << argv[i] << ".\n";
+        return 1;
+      }
+      cameras.push_back(camera);
+    } else if (0 == std::strcmp("--cameras", argv[i]) && i + 1 < argc) {
+      if (!ReadCameraFile(argv[++i], &cameras)) return 1;
+    } else if (0 == std::strcmp("--output-prefix", argv[i]) && i + 1 < argc) {
+      output_prefix = argv[++i];
+    } else if (0 == std::strcmp("--rle", argv[i])) {
+      rle = true;
+    } else if (0 == std::strcmp("--format", argv[i]) && i + 1 < argc) {
+      format = argv[++i];
+    } else if (0 == std::strcmp("--png-level", argv[i]) && i + 1 < argc) {
+      const char* level = argv[++i];
+      if (0 == std::strcmp("stored", level)) {
+        png_level = PngEncoder::kStored;
+      } else if (0 == std::strcmp("fast", level)) {
+        png_level = PngEncoder::kFast;
+      } else if (0 == std::strcmp("small", level)) {
+        png_level = PngEncoder::kSmall;
+      } else {
+        std::cerr << "Unknown PNG level " << level << ".\n";
+        return 1;
+      }
+    } else if (0 == std::strcmp("--profile", argv[i]) && i + 1 < argc) {
+      profile_filename = argv[++i];
+    } else if (0 == std::strcmp("--trace", argv[i]) && i + 1 < argc) {
+      trace_filename = argv[++i];
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << ".\n";
+      return 1;
+    }
+  }
+  std::unique_ptr<ImageEncoder> encoder;
+  if ("tga" == format) {
+    encoder.reset(new TgaEncoder(rle));
+  } else if ("raw" == format) {
+    encoder.reset(new RawEncoder());
+  } else if ("ppm" == format) {
+    encoder.reset(new PpmEncoder());
+  } else if ("png" == format) {
+    encoder.reset(new PngEncoder(png_level));
+  } else {
+    std::cerr << "Unknown output format " << format << ".\n";
+    return 1;
+  }
+  if (stream_budget && !cameras.empty()) {
+    std::cerr << "--stream can't be used with cameras.\n";
+    return 1;
+  }
+  if (!profile_filename.empty() || !trace_filename.empty()) {
+    if (!kProfilerEnabled) {
+      std::cerr << "Profiling was disabled at compile time.\n";
+      return 1;
+    }
+    Profiler::Global().SetEnabled(true);
+  }
+  const std::string obj_filename = "/home/tea/my-renderer/obj/african_head.obj";
+  const std::string cache_filename = obj_filename + ".mesh";
+  const std::string texture_filename =
+      "/home/tea/my-renderer/obj/african_head_diffuse.tga";
+  ObjModel* head = nullptr;
+  {
+    ScopedTimer timer(Profiler::kModelLoad, Profiler::kSetupFrame);
+    bool cache_valid = IsMeshCacheFresh(obj_filename, cache_filename);
+    if (cache_valid && stream_budget) {
+      // 流式渲染由MeshStream逐段检查面下标，这里只检查文件头，
+      // 不读入整个模型
+      MappedFile file;
+      MeshCacheHeader header;
+      cache_valid = file.Open(cache_filename) &&
+                    ReadMeshCacheHeader(file, cache_filename, &header);
+    } else if (cache_valid) {
+      head = new ObjModel(cache_filename);
+      // 损坏的缓存得到空模型，此时重新解析.obj并覆盖缓存
+      if (0 == head->GetFaceNum()) {
+        delete head;
+        head = nullptr;
+        cache_valid = false;
+      }
+    }
+    if (!cache_valid) {
+      head = new ObjModel(obj_filename, &ThreadPool::Global());
+      head->WriteMeshCache(cache_filename);
+    }
+  }
+  if (!cameras.empty()) {
+    IndexedMesh mesh(*head);
+    delete head;
+    if (optimize_mesh) mesh.OptimizeVertexCache();
+    RenderBatch(mesh, texture_filename, cameras, output_prefix, encoder.get(),
+                width, height);
+    return WriteProfile(profile_filename, trace_filename) ? 0 : 1;
+  }
+  if (stream_budget) {
+    // 流式渲染直接读取缓存文件，不保留整个模型
+    delete head;
+    head = nullptr;
+  }
+  ColorBuffer canvas(width, height);
+  Texture texture;
+  {
+    ScopedTimer timer(Profiler::kTextureLoad, Profiler::kSetupFrame);
+    texture = LoadTexture(texture_filename, &ThreadPool::Global());
+  }
+  TextureShader shader(&texture);
+  shader.RegisterCanvas(&canvas);
   shader.LookAt(camera_pos, gaze_dir, up);
   shader.Projection(-1.5);
-  shader.SetViewPort(width, height);
 
-  int pixel_num = width * height;
-  std::vector<double> zbuffer(pixel_num, std::numeric_limits<double>::lowest());
+  Rasterizer rasterizer(width, height, &ThreadPool::Global(), depth_format);
+  if (fixed_point) rasterizer.SetPrecisionMode(Rasterizer::kFixedPoint);
+  PrimitiveAssembler assembler(width, height);
+  assembler.SetCullMode(PrimitiveAssembler::kCullBack);
+  assembler.SetFrontFace(PrimitiveAssembler::kCounterClockwise);
 
-  int face_num = head->GetFaceNum();
-  std::array<Vector4, 3> vertices;
-  std::array<Vector2, 3> textures;
-  for (int i = 0; i < face_num; ++i) {
-    Vector3Int face = head->GetFaceVertices(i);
-    Vector3Int face_texture = head->GetFaceVertexTextures(i);
-    for (int i = 0; i < 3; i++) {
-      vertices[i] = shader.vertex_process(
-          vector_m::HomogeneousCoords(head->GetVertex(face[i])));
-      shader.SetTextureCoordinates(head->GetTexture(face_texture[i]), i);
+  if (stream_budget) {
+    RenderStreaming(cache_filename, stream_budget, &shader, &assembler,
+                    &rasterizer);
+  } else {
+    IndexedMesh mesh(*head);
+    if (optimize_mesh) mesh.OptimizeVertexCache();
+    VertexStage vertex_stage(mesh, &ThreadPool::Global());
+    {
+      ScopedTimer timer(Profiler::kVertexProcessing, 0);
+      vertex_stage.Process(shader.GetMvp());
     }
-    Rasterization(vertices, zbuffer, width, &shader);
+
+    {
+      ScopedTimer timer(Profiler::kPrimitiveAssembly, 0);
+      const std::vector<std::uint32_t>& indices = mesh.GetIndices();
+      Triangle triangle;
+      for (std::size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; ++k) {
+          int index = indices[i + k];
+          const double* uv = mesh.GetVertex(index).texture_coordinates;
+          triangle.vertices[k] = vertex_stage.GetClipVertex(index);
+          triangle.texture_coordinates[k] = Vector2{uv[0], uv[1]};
+        }
+        assembler.Assemble(triangle, &rasterizer);
+      }
+    }
+    ScopedTimer timer(Profiler::kRasterization, 0);
+    rasterizer.Flush(&shader);
   }
+  PrimitiveAssembler::Stats stats = assembler.GetStats();
+  if (Profiler::Global().IsEnabled()) {
+    Profiler::Global().AddRenderStats(0, stats, rasterizer.GetStats());
+  }
+  std::cerr << "triangles: " << stats.triangles_in
+            << ", back-face culled: " << stats.backface_culled
+            << ", frustum culled: " << stats.frustum_culled
+            << ", clipped: " << stats.clipped
+            << ", rasterized: " << stats.triangles_out << ".\n";
   shader.UnregisterCanvas();
-  image->WriteTgaFile("african-head.tga", false, false, false);
+  {
+    ScopedTimer timer(Profiler::kImageWrite, 0);
+    TgaImage image;
+    canvas.ToTgaImage(&image, &ThreadPool::Global());
+    encoder->Write(image, "african-head." + encoder->GetExtension(),
+                   &ThreadPool::Global());
+  }
   delete head;
-  delete image;
+  return WriteProfile(profile_filename, trace_filename) ? 0 : 1;
 }
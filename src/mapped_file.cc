@@ -0,0 +1,71 @@
+#include "include/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <utility>
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+MappedFile::MappedFile(MappedFile&& file) noexcept
+    : data_(file.data_), size_(file.size_) {
+  file.data_ = nullptr;
+  file.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept {
+  if (this != &rhs) {
+    Close();
+    std::swap(data_, rhs.data_);
+    std::swap(size_, rhs.size_);
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string& filename) {
+  Close();
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (-1 == fd) {
+    std::cerr << "Can't open file " << filename << ".\n";
+    return false;
+  }
+  struct stat st;
+  if (-1 == fstat(fd, &st) || 0 >= st.st_size) {
+    std::cerr << "Can't map empty file " << filename << ".\n";
+    close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // 映射建立后文件描述符即可关闭
+  close(fd);
+  if (MAP_FAILED == data) {
+    std::cerr << "Can't map file " << filename << ".\n";
+    return false;
+  }
+  data_ = static_cast<const unsigned char*>(data);
+  size_ = static_cast<std::size_t>(st.st_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) munmap(const_cast<unsigned char*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void MappedFile::DropPages(std::size_t offset, std::size_t length) const {
+  if (!data_ || offset >= size_) return;
+  static const std::size_t kPageSize = sysconf(_SC_PAGESIZE);
+  std::size_t begin = offset / kPageSize * kPageSize;
+  std::size_t end = std::min(size_, offset + length);
+  madvise(const_cast<unsigned char*>(data_) + begin, end - begin,
+          MADV_DONTNEED);
+}
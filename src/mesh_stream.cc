@@ -0,0 +1,171 @@
+#include "include/mesh_stream.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "include/mapped_file.h"
+#include "include/model.h"
+
+MeshStream::MeshStream(const std::string& filename, int chunk_face_num,
+                       std::size_t vertex_budget)
+    : header_(),
+      chunk_face_num_(std::max(1, chunk_face_num)),
+      vertex_budget_(vertex_budget),
+      touched_bytes_(0),
+      done_(false),
+      stop_(false) {
+  if (!file_.Open(filename) ||
+      !ReadMeshCacheHeader(file_, filename, &header_)) {
+    file_.Close();
+    done_ = true;
+    return;
+  }
+  touched_blocks_.resize(file_.GetSize() / kResidencyBlock + 1);
+  // 预算大于整个模型时分段不超过面数
+  chunk_face_num_ = static_cast<int>(std::max<std::size_t>(
+      1, std::min<std::size_t>(chunk_face_num_, header_.face_num)));
+  for (Chunk& chunk : chunks_) {
+    std::size_t corner_num = 3 * static_cast<std::size_t>(chunk_face_num_);
+    chunk.x.resize(corner_num);
+    chunk.y.resize(corner_num);
+    chunk.z.resize(corner_num);
+    chunk.u.resize(corner_num);
+    chunk.v.resize(corner_num);
+    free_chunks_.push_back(&chunk);
+  }
+  producer_ = std::thread(&MeshStream::ProducerLoop, this);
+}
+
+MeshStream::~MeshStream() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (producer_.joinable()) producer_.join();
+}
+
+bool MeshStream::IsOpen() const { return file_.IsOpen(); }
+
+std::size_t MeshStream::GetFaceNum() const {
+  return IsOpen() ? header_.face_num : 0;
+}
+
+int MeshStream::GetChunkFaceNum() const { return chunk_face_num_; }
+
+const MeshStream::Chunk* MeshStream::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !ready_chunks_.empty() || done_; });
+  if (ready_chunks_.empty()) return nullptr;
+  Chunk* chunk = ready_chunks_.front();
+  ready_chunks_.pop_front();
+  return chunk;
+}
+
+void MeshStream::Release(const Chunk* chunk) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_chunks_.push_back(const_cast<Chunk*>(chunk));
+  }
+  cv_.notify_all();
+}
+
+void MeshStream::ProducerLoop() {
+  std::size_t face_num = header_.face_num;
+  for (std::size_t begin = 0; begin < face_num; begin += chunk_face_num_) {
+    Chunk* chunk = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !free_chunks_.empty() || stop_; });
+      if (stop_) return;
+      chunk = free_chunks_.front();
+      free_chunks_.pop_front();
+    }
+    chunk->face_num = static_cast<int>(
+        std::min<std::size_t>(chunk_face_num_, face_num - begin));
+    bool ok = Fill(begin, chunk);
+    // 面下标按顺序读取，读过的部分不会再用到
+    std::size_t index_size = 3 * sizeof(int);
+    for (int k = 3; k < 6; ++k) {
+      file_.DropPages(header_.offsets[k] + begin * index_size,
+                      chunk->face_num * index_size);
+    }
+    // 顶点与纹理坐标会被之后的分段再次访问，只在超出预算时整体释放
+    if (touched_bytes_ > vertex_budget_) {
+      file_.DropPages(header_.offsets[0],
+                      header_.vertex_num * 3 * sizeof(double));
+      file_.DropPages(header_.offsets[1],
+                      header_.texture_num * 2 * sizeof(double));
+      std::fill(touched_blocks_.begin(), touched_blocks_.end(), false);
+      touched_bytes_ = 0;
+    }
+    if (!ok) {
+      std::cerr << "Mesh cache references nonexistent vertices in faces "
+                << begin << "-" << begin + chunk->face_num << ".\n";
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_chunks_.push_back(chunk);
+      break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_chunks_.push_back(chunk);
+    }
+    cv_.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  cv_.notify_all();
+}
+
+bool MeshStream::Fill(std::size_t begin, Chunk* chunk) {
+  if (!CheckMeshCacheFaces(file_, header_, begin, chunk->face_num)) {
+    return false;
+  }
+  const unsigned char* data = file_.GetData();
+  const double* vertices =
+      reinterpret_cast<const double*>(data + header_.offsets[0]);
+  const double* textures =
+      reinterpret_cast<const double*>(data + header_.offsets[1]);
+  const int* face_vertices =
+      reinterpret_cast<const int*>(data + header_.offsets[3]) + 3 * begin;
+  const int* face_textures =
+      reinterpret_cast<const int*>(data + header_.offsets[4]) + 3 * begin;
+  int corner_num = 3 * chunk->face_num;
+  for (int i = 0; i < corner_num; ++i) {
+    std::size_t vertex = static_cast<std::size_t>(face_vertices[i]);
+    Touch(header_.offsets[0] + 3 * sizeof(double) * vertex,
+          3 * sizeof(double));
+    const double* p = vertices + 3 * vertex;
+    chunk->x[i] = p[0];
+    chunk->y[i] = p[1];
+    chunk->z[i] = p[2];
+    int t = face_textures[i];
+    if (0 > t) {
+      chunk->u[i] = 0;
+      chunk->v[i] = 0;
+    } else {
+      Touch(header_.offsets[1] + 2 * sizeof(double) * t, 2 * sizeof(double));
+      chunk->u[i] = textures[2 * static_cast<std::size_t>(t)];
+      chunk->v[i] = textures[2 * static_cast<std::size_t>(t) + 1];
+    }
+  }
+  return true;
+}
+
+void MeshStream::Touch(std::size_t offset, std::size_t length) {
+  // 元素可能跨越两个块
+  for (std::size_t block : {offset / kResidencyBlock,
+                            (offset + length - 1) / kResidencyBlock}) {
+    if (!touched_blocks_[block]) {
+      touched_blocks_[block] = true;
+      touched_bytes_ += kResidencyBlock;
+    }
+  }
+}
@@ -1,125 +1,498 @@
 #include "include/model.h"
 
+#include <sys/stat.h>
+
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <limits>
-#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "include/geometry.h"
+#include "include/mapped_file.h"
+#include "include/thread_pool.h"
+
+namespace {
+const char kMeshCacheMagic[8] = {'R', 'M', 'E', 'S', 'H', 'B', 'I', 'N'};
+// 格式变化时递增，旧版本的缓存会被拒绝
+const std::uint32_t kMeshCacheVersion = 1;
+const std::uint32_t kMeshCacheByteOrder = 0x01020304;
+const std::uint64_t kMeshCacheAlignment = 64;
+// 并行解析时每个分段的最小字节数
+const std::size_t kObjChunkMinSize = 1 << 18;
+// 最多逐行报告的格式错误的面，其余只计数
+const std::size_t kMaxReportedFaces = 8;
+
+static_assert(4 == sizeof(int), "mesh cache stores indices as int32");
+
+std::uint64_t AlignUp(std::uint64_t offset) {
+  return (offset + kMeshCacheAlignment - 1) & ~(kMeshCacheAlignment - 1);
+}
+
+
+// 文本解析时一个分段的结果。
+// 面的下标已转换为从0开始的绝对下标；相对下标(负数)依赖之前所有
+// 分段的元素数，先记录为相对本分段开头的下标，合并时再加上偏移。
+struct ObjChunk {
+  std::vector<double> vertices;
+  std::vector<double> textures;
+  std::vector<double> normals;
+  std::vector<int> face_vertices;
+  std::vector<int> face_textures;
+  std::vector<int> face_normals;
+  // 需要修正的下标位置，按数组分别记录：0顶点、1纹理坐标、2法线
+  std::vector<std::size_t> relative[3];
+  // 分段中的行数
+  std::size_t line_num = 0;
+  // 格式错误而被跳过的面数，以及前几个的行号(相对本分段开头，从0开始)
+  // 与该行内容
+  std::size_t malformed_num = 0;
+  std::vector<std::pair<std::size_t, std::string>> malformed;
+};
+
+bool IsBlank(char c) { return ' ' == c || '\t' == c || '\r' == c; }
+
+const char* SkipBlank(const char* p, const char* end) {
+  while (p < end && IsBlank(*p)) ++p;
+  return p;
+}
+
+// 读取以空白分隔的数值，缺省或无法解析时保持value不变
+const char* ParseDouble(const char* p, const char* end, double* value) {
+  p = SkipBlank(p, end);
+  // from_chars不接受前导'+'
+  if (p < end && '+' == *p) ++p;
+  std::from_chars_result result = std::from_chars(p, end, *value);
+  return result.ptr;
+}
 
-ObjModel::ObjModel(const std::string& filename) {
-  std::ifstream in;
-  in.open(filename.c_str());
-  if (!in.is_open()) {
-    in.close();
-    std::cerr << "Can't open file " << filename << " .\n";
-    return;
-  }
-  std::string line;
-  while (std::getline(in, line)) {
-    if (line.empty() || '#' == line[0]) continue;
-    std::istringstream iss(line);
-    if (0 == line.compare(0, 2, "v ")) {
+// 解析面的一个顶点 v、v/vt、v//vn 或 v/vt/vn
+// @param index 依次存放v、vt、vn，省略的分量为0
+// @return 解析失败时返回nullptr
+const char* ParseFaceCorner(const char* p, const char* end, int index[3]) {
+  index[0] = index[1] = index[2] = 0;
+  std::from_chars_result result = std::from_chars(p, end, index[0]);
+  if (std::errc() != result.ec) return nullptr;
+  p = result.ptr;
+  for (int k = 1; k < 3 && p < end && '/' == *p; ++k) {
+    ++p;
+    result = std::from_chars(p, end, index[k]);
+    if (std::errc() == result.ec) p = result.ptr;
+  }
+  return p;
+}
+
+// 解析[begin, end)中的完整行
+void ParseObjChunk(const char* begin, const char* end, ObjChunk* chunk) {
+  // 当前面的各个顶点，多边形按扇形拆分时需要第一个顶点
+  std::vector<std::array<int, 3>> corners;
+  const char* line = begin;
+  while (line < end) {
+    const char* line_end =
+        static_cast<const char*>(std::memchr(line, '\n', end - line));
+    if (!line_end) line_end = end;
+    const char* p = SkipBlank(line, line_end);
+    if (p + 1 < line_end && 'v' == p[0] && IsBlank(p[1])) {
       // geometric vertices
-      iss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-      Vector3 vertex;
-      int i = 0;
-      std::string value;
-      while (iss && 3 > i) {
-        iss >> value;
-        vertex[i] = std::stod(value);
-        ++i;
-      }
-      vertices_.push_back(vertex);
-    } else if (0 == line.compare(0, 2, "vt")) {
+      double v[3] = {0, 0, 0};
+      p += 1;
+      for (int i = 0; i < 3; ++i) p = ParseDouble(p, line_end, v + i);
+      chunk->vertices.insert(chunk->vertices.end(), v, v + 3);
+    } else if (p + 2 < line_end && 'v' == p[0] && 't' == p[1] &&
+               IsBlank(p[2])) {
       // texture coordinates
-      iss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-      Vector2 texture;
-      int i = 0;
-      std::string value;
-      while (iss && 2 > i) {
-        iss >> value;
-        texture[i] = std::stod(value);
-        ++i;
-      }
-      textures_.push_back(texture);
-      continue;
-    } else if (0 == line.compare(0, 2, "vn")) {
+      double vt[2] = {0, 0};
+      p += 2;
+      for (int i = 0; i < 2; ++i) p = ParseDouble(p, line_end, vt + i);
+      chunk->textures.insert(chunk->textures.end(), vt, vt + 2);
+    } else if (p + 2 < line_end && 'v' == p[0] && 'n' == p[1] &&
+               IsBlank(p[2])) {
       // vertex normal
-      // original data might not be unit vectors, so normalize manually
-      iss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-      Vector3 normal;
-      int i = 0;
-      std::string value;
-      while (iss && 3 > i) {
-        iss >> value;
-        normal[i] = std::stod(value);
-        ++i;
+      double vn[3] = {0, 0, 0};
+      p += 2;
+      for (int i = 0; i < 3; ++i) p = ParseDouble(p, line_end, vn + i);
+      chunk->normals.insert(chunk->normals.end(), vn, vn + 3);
+    } else if (p + 1 < line_end && 'f' == p[0] && IsBlank(p[1])) {
+      // polygonal face element
+      corners.clear();
+      p = SkipBlank(p + 1, line_end);
+      // 最后一个顶点之后可以是'#'开头的注释
+      while (p < line_end && '#' != *p) {
+        std::array<int, 3> corner;
+        p = ParseFaceCorner(p, line_end, corner.data());
+        if (!p || (p < line_end && !IsBlank(*p) && '#' != *p)) {
+          // 跳过整个面，与下标越界的面一样丢弃
+          if (chunk->malformed.size() < kMaxReportedFaces) {
+            chunk->malformed.emplace_back(chunk->line_num,
+                                          std::string(line, line_end));
+          }
+          ++chunk->malformed_num;
+          corners.clear();
+          break;
+        }
+        corners.push_back(corner);
+        p = SkipBlank(p, line_end);
       }
-      normals_.push_back(normal);
-    } else if (0 == line.compare(0, 2, "f ")) {
-      // polygonal face elemnt
-      iss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-      Vector3Int face_vertices;
-      Vector3Int face_vertex_textures;
-      Vector3Int face_vertex_normals;
-      std::string vertex_data_str;
-      int i = 0;
-      std::array<std::string, 3> array;
-      while (3 > i) {
-        iss >> vertex_data_str;
-        SplitObjFaceVertexStr(vertex_data_str, array);
-        face_vertices[i] = std::stoi(array[0]) - 1;
-        face_vertex_textures[i] = std::stoi(array[1]) - 1;
-        face_vertex_normals[i] = std::stoi(array[2]) - 1;
-        ++i;
+      const std::size_t counts[3] = {chunk->vertices.size() / 3,
+                                     chunk->textures.size() / 2,
+                                     chunk->normals.size() / 3};
+      std::vector<int>* arrays[3] = {&chunk->face_vertices,
+                                     &chunk->face_textures,
+                                     &chunk->face_normals};
+      for (std::size_t i = 1; i + 1 < corners.size(); ++i) {
+        for (std::size_t c : {std::size_t(0), i, i + 1}) {
+          for (int k = 0; k < 3; ++k) {
+            int index = corners[c][k];
+            if (0 > index) {
+              chunk->relative[k].push_back(arrays[k]->size());
+              index += static_cast<int>(counts[k]);
+            } else {
+              // 缺省的分量记为-1
+              index -= 1;
+            }
+            arrays[k]->push_back(index);
+          }
+        }
+      }
+    }
+    line = line_end + 1;
+    ++chunk->line_num;
+  }
+}
+}  // namespace
+
+ObjModel::ObjModel(const std::string& filename, ThreadPool* pool)
+    : vertices_(nullptr),
+      textures_(nullptr),
+      normals_(nullptr),
+      faces_vertices_(nullptr),
+      faces_vertex_textures_(nullptr),
+      faces_vertex_normals_(nullptr),
+      vertex_num_(0),
+      texture_num_(0),
+      normal_num_(0),
+      face_num_(0) {
+  MappedFile file;
+  if (!file.Open(filename)) return;
+  if (!MapMeshCache(&file, filename)) ParseObj(file, pool);
+}
+
+void ObjModel::ParseObj(const MappedFile& file, ThreadPool* pool) {
+  const char* data = reinterpret_cast<const char*>(file.GetData());
+  const char* end = data + file.GetSize();
+  // 按大小等分后把边界推迟到下一个换行之后，每段都由完整的行组成
+  int chunk_num = 1;
+  if (pool) {
+    chunk_num = static_cast<int>(std::min<std::size_t>(
+        pool->GetThreadNum() * 4, file.GetSize() / kObjChunkMinSize + 1));
+  }
+  std::vector<const char*> bounds(chunk_num + 1, end);
+  bounds[0] = data;
+  for (int i = 1; i < chunk_num; ++i) {
+    const char* p = std::max(bounds[i - 1],
+                             data + file.GetSize() / chunk_num * i);
+    const char* newline =
+        static_cast<const char*>(std::memchr(p, '\n', end - p));
+    bounds[i] = newline ? newline + 1 : end;
+  }
+  std::vector<ObjChunk> chunks(chunk_num);
+  auto parse = [&bounds, &chunks](int i) {
+    ParseObjChunk(bounds[i], bounds[i + 1], &chunks[i]);
+  };
+  if (pool) {
+    pool->ParallelFor(0, chunk_num, parse);
+  } else {
+    parse(0);
+  }
+
+  // 按顺序合并，并修正相对下标
+  std::size_t totals[6] = {0, 0, 0, 0, 0, 0};
+  std::size_t line_offset = 0;
+  std::size_t malformed_num = 0;
+  std::size_t reported = 0;
+  for (const ObjChunk& chunk : chunks) {
+    for (const auto& face : chunk.malformed) {
+      if (kMaxReportedFaces <= reported) break;
+      std::cerr << "Malformed face element at line "
+                << line_offset + face.first + 1 << ": " << face.second
+                << "\n";
+      ++reported;
+    }
+    line_offset += chunk.line_num;
+    malformed_num += chunk.malformed_num;
+    totals[0] += chunk.vertices.size();
+    totals[1] += chunk.textures.size();
+    totals[2] += chunk.normals.size();
+    totals[3] += chunk.face_vertices.size();
+  }
+  vertex_data_.reserve(totals[0]);
+  texture_data_.reserve(totals[1]);
+  normal_data_.reserve(totals[2]);
+  face_vertex_data_.reserve(totals[3]);
+  face_texture_data_.reserve(totals[3]);
+  face_normal_data_.reserve(totals[3]);
+  std::vector<int>* faces[3] = {&face_vertex_data_, &face_texture_data_,
+                                &face_normal_data_};
+  for (ObjChunk& chunk : chunks) {
+    const int offsets[3] = {static_cast<int>(vertex_data_.size() / 3),
+                            static_cast<int>(texture_data_.size() / 2),
+                            static_cast<int>(normal_data_.size() / 3)};
+    std::size_t face_offset = face_vertex_data_.size();
+    const std::vector<int>* chunk_faces[3] = {
+        &chunk.face_vertices, &chunk.face_textures, &chunk.face_normals};
+    for (int k = 0; k < 3; ++k) {
+      faces[k]->insert(faces[k]->end(), chunk_faces[k]->begin(),
+                       chunk_faces[k]->end());
+      for (std::size_t i : chunk.relative[k]) {
+        (*faces[k])[face_offset + i] += offsets[k];
+      }
+    }
+    vertex_data_.insert(vertex_data_.end(), chunk.vertices.begin(),
+                        chunk.vertices.end());
+    texture_data_.insert(texture_data_.end(), chunk.textures.begin(),
+                         chunk.textures.end());
+    normal_data_.insert(normal_data_.end(), chunk.normals.begin(),
+                        chunk.normals.end());
+    chunk = ObjChunk();
+  }
+
+  // 顶点下标越界的面被丢弃，纹理坐标和法线下标越界视为缺省
+  const int counts[3] = {static_cast<int>(vertex_data_.size() / 3),
+                         static_cast<int>(texture_data_.size() / 2),
+                         static_cast<int>(normal_data_.size() / 3)};
+  std::size_t face_end = 0;
+  std::size_t dropped = 0;
+  for (std::size_t i = 0; i < face_vertex_data_.size(); i += 3) {
+    bool valid = true;
+    for (std::size_t j = i; j < i + 3; ++j) {
+      int v = face_vertex_data_[j];
+      valid = valid && 0 <= v && v < counts[0];
+    }
+    if (!valid) {
+      ++dropped;
+      continue;
+    }
+    for (std::size_t j = i; j < i + 3; ++j) {
+      for (int k = 0; k < 3; ++k) {
+        int index = (*faces[k])[j];
+        (*faces[k])[face_end + j - i] =
+            (0 <= index && index < counts[k]) ? index : -1;
       }
-      faces_vertices_.push_back(face_vertices);
-      faces_vertex_textures_.push_back(face_vertex_textures);
-      faces_vertex_normals_.push_back(face_vertex_normals);
     }
+    face_end += 3;
+  }
+  if (malformed_num) {
+    std::cerr << malformed_num << " malformed face elements skipped.\n";
+  }
+  if (dropped) {
+    std::cerr << dropped << " faces reference nonexistent vertices.\n";
   }
-  in.close();
+  for (int k = 0; k < 3; ++k) faces[k]->resize(face_end);
+
+  vertices_ = vertex_data_.data();
+  textures_ = texture_data_.data();
+  normals_ = normal_data_.data();
+  faces_vertices_ = face_vertex_data_.data();
+  faces_vertex_textures_ = face_texture_data_.data();
+  faces_vertex_normals_ = face_normal_data_.data();
+  vertex_num_ = counts[0];
+  texture_num_ = counts[1];
+  normal_num_ = counts[2];
+  face_num_ = face_end / 3;
 }
 
 ObjModel::~ObjModel() = default;
 
-Vector3 ObjModel::GetVertex(int index) const { return vertices_[index]; }
+bool ObjModel::MapMeshCache(MappedFile* file, const std::string& filename) {
+  if (!IsMeshCache(*file)) return false;
+  MeshCacheHeader header;
+  if (!ReadMeshCacheHeader(*file, filename, &header)) return true;
+  if (!CheckMeshCacheFaces(*file, header, 0, header.face_num)) {
+    std::cerr << "Mesh cache " << filename
+              << " references nonexistent vertices.\n";
+    return true;
+  }
+  const unsigned char* data = file->GetData();
+  vertices_ = reinterpret_cast<const double*>(data + header.offsets[0]);
+  textures_ = reinterpret_cast<const double*>(data + header.offsets[1]);
+  normals_ = reinterpret_cast<const double*>(data + header.offsets[2]);
+  faces_vertices_ = reinterpret_cast<const int*>(data + header.offsets[3]);
+  faces_vertex_textures_ =
+      reinterpret_cast<const int*>(data + header.offsets[4]);
+  faces_vertex_normals_ =
+      reinterpret_cast<const int*>(data + header.offsets[5]);
+  vertex_num_ = header.vertex_num;
+  texture_num_ = header.texture_num;
+  normal_num_ = header.normal_num;
+  face_num_ = header.face_num;
+  cache_ = std::move(*file);
+  return true;
+}
+
+bool ObjModel::WriteMeshCache(const std::string& filename) const {
+  MeshCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMeshCacheMagic, sizeof(kMeshCacheMagic));
+  header.version = kMeshCacheVersion;
+  header.byte_order = kMeshCacheByteOrder;
+  header.vertex_num = vertex_num_;
+  header.texture_num = texture_num_;
+  header.normal_num = normal_num_;
+  header.face_num = face_num_;
+  const void* arrays[6] = {vertices_,       textures_,
+                           normals_,        faces_vertices_,
+                           faces_vertex_textures_,
+                           faces_vertex_normals_};
+  const std::uint64_t sizes[6] = {
+      vertex_num_ * 3 * sizeof(double), texture_num_ * 2 * sizeof(double),
+      normal_num_ * 3 * sizeof(double), face_num_ * 3 * sizeof(int),
+      face_num_ * 3 * sizeof(int),      face_num_ * 3 * sizeof(int)};
+  std::uint64_t offset = AlignUp(sizeof(header));
+  for (int i = 0; i < 6; ++i) {
+    header.offsets[i] = offset;
+    offset = AlignUp(offset + sizes[i]);
+  }
+  header.file_size = offset;
 
-Vector2 ObjModel::GetTexture(int index) const { return textures_[index]; }
+  std::ofstream out;
+  out.open(filename.c_str(), std::ios::binary);
+  if (!out.is_open()) {
+    std::cerr << "Can't open file " << filename << ".\n";
+    return false;
+  }
+  const char padding[kMeshCacheAlignment] = {};
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  std::uint64_t written = sizeof(header);
+  for (int i = 0; i < 6; ++i) {
+    out.write(padding, header.offsets[i] - written);
+    if (sizes[i]) {
+      out.write(static_cast<const char*>(arrays[i]), sizes[i]);
+    }
+    written = header.offsets[i] + sizes[i];
+  }
+  out.write(padding, header.file_size - written);
+  if (!out.good()) {
+    std::cerr << "An error occurred while writing mesh cache " << filename
+              << ".\n";
+    return false;
+  }
+  out.close();
+  return true;
+}
+
+bool ObjModel::IsMapped() const { return cache_.IsOpen(); }
 
-Vector3 ObjModel::GetNormal(int index) const { return normals_[index]; }
+Vector3 ObjModel::GetVertex(int index) const {
+  const double* p = vertices_ + 3 * static_cast<std::size_t>(index);
+  return Vector3{p[0], p[1], p[2]};
+}
 
-std::size_t ObjModel::GetFaceNum() const { return faces_vertices_.size(); }
+Vector2 ObjModel::GetTexture(int index) const {
+  if (0 > index) return Vector2();
+  const double* p = textures_ + 2 * static_cast<std::size_t>(index);
+  return Vector2{p[0], p[1]};
+}
+
+Vector3 ObjModel::GetNormal(int index) const {
+  if (0 > index) return Vector3();
+  const double* p = normals_ + 3 * static_cast<std::size_t>(index);
+  return Vector3{p[0], p[1], p[2]};
+}
+
+std::size_t ObjModel::GetVertexNum() const { return vertex_num_; }
+
+std::size_t ObjModel::GetFaceNum() const { return face_num_; }
 
 Vector3Int ObjModel::GetFaceVertices(int index) const {
-  return faces_vertices_[index];
+  const int* p = faces_vertices_ + 3 * static_cast<std::size_t>(index);
+  return Vector3Int{p[0], p[1], p[2]};
 }
 
 Vector3Int ObjModel::GetFaceVertexTextures(int index) const {
-  return faces_vertex_textures_[index];
+  const int* p = faces_vertex_textures_ + 3 * static_cast<std::size_t>(index);
+  return Vector3Int{p[0], p[1], p[2]};
 }
 
 Vector3Int ObjModel::GetFaceVertexNormals(int index) const {
-  return faces_vertex_normals_[index];
-}
-
-void SplitObjFaceVertexStr(const std::string& vertex_data_str,
-                           std::array<std::string, 3>& array) {
-  int len = vertex_data_str.length();
-  int last = 0;
-  int cur = 0;
-  for (int i = 0; i < len; ++i) {
-    if ('/' == vertex_data_str[i]) {
-      array[cur] = vertex_data_str.substr(last, i - last);
-      last = i + 1;
-      cur++;
+  const int* p = faces_vertex_normals_ + 3 * static_cast<std::size_t>(index);
+  return Vector3Int{p[0], p[1], p[2]};
+}
+
+bool IsMeshCache(const MappedFile& file) {
+  return file.GetSize() >= sizeof(MeshCacheHeader) &&
+         0 == std::memcmp(file.GetData(), kMeshCacheMagic,
+                          sizeof(kMeshCacheMagic));
+}
+
+bool ReadMeshCacheHeader(const MappedFile& file, const std::string& filename,
+                         MeshCacheHeader* header) {
+  if (!IsMeshCache(file)) {
+    std::cerr << filename << " is not a mesh cache.\n";
+    return false;
+  }
+  std::memcpy(header, file.GetData(), sizeof(*header));
+  if (kMeshCacheVersion != header->version ||
+      kMeshCacheByteOrder != header->byte_order) {
+    std::cerr << "Mesh cache " << filename
+              << " was written by an incompatible version.\n";
+    return false;
+  }
+  if (header->file_size != file.GetSize()) {
+    std::cerr << "Mesh cache " << filename << " is truncated.\n";
+    return false;
+  }
+  const std::uint64_t counts[6] = {header->vertex_num, header->texture_num,
+                                   header->normal_num, header->face_num,
+                                   header->face_num,   header->face_num};
+  const std::uint64_t element_sizes[6] = {
+      3 * sizeof(double), 2 * sizeof(double), 3 * sizeof(double),
+      3 * sizeof(int),    3 * sizeof(int),    3 * sizeof(int)};
+  for (int i = 0; i < 6; ++i) {
+    // 先按文件大小限制元素数，之后的乘法不会溢出
+    if (counts[i] > header->file_size / element_sizes[i] ||
+        0 != header->offsets[i] % kMeshCacheAlignment ||
+        header->offsets[i] > header->file_size ||
+        counts[i] * element_sizes[i] >
+            header->file_size - header->offsets[i]) {
+      std::cerr << "Mesh cache " << filename << " is corrupted.\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CheckMeshCacheFaces(const MappedFile& file, const MeshCacheHeader& header,
+                         std::size_t begin, std::size_t count) {
+  const unsigned char* data = file.GetData();
+  // 面下标为int32，超出int范围的元素无法被引用，按int范围比较即可
+  const std::int64_t counts[3] = {
+      static_cast<std::int64_t>(header.vertex_num),
+      static_cast<std::int64_t>(header.texture_num),
+      static_cast<std::int64_t>(header.normal_num)};
+  for (int k = 0; k < 3; ++k) {
+    const int* indices =
+        reinterpret_cast<const int*>(data + header.offsets[3 + k]) + 3 * begin;
+    // 顶点下标必须有效，纹理坐标与法线下标可以为-1(缺省)
+    std::int64_t min_index = 0 == k ? 0 : -1;
+    int invalid = 0;
+    for (std::size_t i = 0; i < 3 * count; ++i) {
+      invalid |= indices[i] < min_index || indices[i] >= counts[k];
     }
+    if (invalid) return false;
   }
-  array[cur] = vertex_data_str.substr(last);
-  return;
+  return true;
+}
+
+bool IsMeshCacheFresh(const std::string& obj_filename,
+                      const std::string& cache_filename) {
+  struct stat obj_stat;
+  struct stat cache_stat;
+  if (0 != stat(cache_filename.c_str(), &cache_stat)) return false;
+  if (0 != stat(obj_filename.c_str(), &obj_stat)) return true;
+  return obj_stat.st_mtime <= cache_stat.st_mtime;
 }
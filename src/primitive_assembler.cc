@@ -0,0 +1,134 @@
+#include "include/primitive_assembler.h"
+
+#include <array>
+#include <utility>
+
+#include "include/geometry.h"
+#include "include/gl.h"
+#include "include/rasterizer.h"
+
+namespace {
+// 点到第plane个裁剪平面的有向距离，内侧为非负
+// plane = 2*axis 对应 c[axis] >= -w，plane = 2*axis+1 对应 c[axis] <= w
+double PlaneDistance(const Vector4& c, int plane) {
+  int axis = plane >> 1;
+  return (plane & 1) ? c[3] - c[axis] : c[3] + c[axis];
+}
+
+int OutCode(const Vector4& c) {
+  int code = 0;
+  for (int plane = 0; plane < 6; ++plane) {
+    if (PlaneDistance(c, plane) < 0) code |= 1 << plane;
+  }
+  return code;
+}
+}  // namespace
+
+PrimitiveAssembler::PrimitiveAssembler(double screen_width,
+                                       double screen_height)
+    : m_vp_(ViewportTransM(screen_width, screen_height)) {}
+
+PrimitiveAssembler::~PrimitiveAssembler() = default;
+
+void PrimitiveAssembler::SetCullMode(CullMode mode) { cull_mode_ = mode; }
+
+void PrimitiveAssembler::SetFrontFace(Winding winding) {
+  front_face_ = winding;
+}
+
+PrimitiveAssembler::Stats PrimitiveAssembler::GetStats() const {
+  return stats_;
+}
+
+void PrimitiveAssembler::ResetStats() { stats_ = Stats(); }
+
+void PrimitiveAssembler::Assemble(const Triangle& triangle,
+                                  Rasterizer* rasterizer) {
+  ++stats_.triangles_in;
+  ClipVertex polygon[2][kMaxClipVertices];
+  for (int i = 0; i < 3; ++i) {
+    polygon[0][i].position = triangle.vertices[i] * -1.;
+    polygon[0][i].texture_coordinates = triangle.texture_coordinates[i];
+  }
+
+  if (kCullNone != cull_mode_) {
+    // 齐次坐标下的背面判定，无需透视除法且对跨越近平面的三角形同样成立：
+    // w>0时 det(x,y,w) = w0*w1*w2 * 2*(NDC中的有向面积)
+    const Vector4& p0 = polygon[0][0].position;
+    const Vector4& p1 = polygon[0][1].position;
+    const Vector4& p2 = polygon[0][2].position;
+    double det = p0[0] * (p1[1] * p2[3] - p1[3] * p2[1]) -
+                 p0[1] * (p1[0] * p2[3] - p1[3] * p2[0]) +
+                 p0[3] * (p1[0] * p2[1] - p1[1] * p2[0]);
+    bool front = kCounterClockwise == front_face_ ? 0 < det : det < 0;
+    if ((kCullBack == cull_mode_) != front) {
+      ++stats_.backface_culled;
+      return;
+    }
+  }
+
+  int code_and = 0x3F;
+  int code_or = 0;
+  for (int i = 0; i < 3; ++i) {
+    int code = OutCode(polygon[0][i].position);
+    code_and &= code;
+    code_or |= code;
+  }
+  if (code_and) {
+    ++stats_.frustum_culled;
+    return;
+  }
+  if (!code_or) {
+    Emit(polygon[0], 3, rasterizer);
+    return;
+  }
+
+  ++stats_.clipped;
+  int cur = 0;
+  int vertex_num = 3;
+  for (int plane = 0; plane < 6; ++plane) {
+    if (!(code_or & (1 << plane))) continue;
+    const ClipVertex* in = polygon[cur];
+    ClipVertex* out = polygon[cur ^ 1];
+    int out_num = 0;
+    for (int i = 0; i < vertex_num; ++i) {
+      const ClipVertex& a = in[i];
+      const ClipVertex& b = in[(i + 1) % vertex_num];
+      double da = PlaneDistance(a.position, plane);
+      double db = PlaneDistance(b.position, plane);
+      if (0 <= da) out[out_num++] = a;
+      if ((0 <= da) != (0 <= db)) {
+        double t = da / (da - db);
+        out[out_num].position = a.position + (b.position - a.position) * t;
+        out[out_num].texture_coordinates =
+            a.texture_coordinates +
+            (b.texture_coordinates - a.texture_coordinates) * t;
+        ++out_num;
+      }
+    }
+    cur ^= 1;
+    vertex_num = out_num;
+    if (3 > vertex_num) return;
+  }
+  Emit(polygon[cur], vertex_num, rasterizer);
+}
+
+void PrimitiveAssembler::Emit(const ClipVertex* polygon, int vertex_num,
+                              Rasterizer* rasterizer) {
+  std::array<Vector4, kMaxClipVertices> screen;
+  for (int i = 0; i < vertex_num; ++i) {
+    const Vector4& c = polygon[i].position;
+    screen[i] = m_vp_ * (c / c[3]);
+  }
+  Triangle triangle;
+  triangle.vertices[0] = screen[0];
+  triangle.texture_coordinates[0] = polygon[0].texture_coordinates;
+  for (int i = 1; i + 1 < vertex_num; ++i) {
+    triangle.vertices[1] = screen[i];
+    triangle.vertices[2] = screen[i + 1];
+    triangle.texture_coordinates[1] = polygon[i].texture_coordinates;
+    triangle.texture_coordinates[2] = polygon[i + 1].texture_coordinates;
+    rasterizer->Submit(triangle);
+    ++stats_.triangles_out;
+  }
+}
@@ -0,0 +1,145 @@
+#include "include/profiler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "include/primitive_assembler.h"
+#include "include/rasterizer.h"
+
+namespace {
+const char* const kStageNames[Profiler::kStageNum] = {
+    "model_load",         "texture_load",  "vertex_processing",
+    "primitive_assembly", "rasterization", "image_write",
+};
+
+const char* const kCounterNames[Profiler::kCounterNum] = {
+    "triangles_submitted",        "triangles_backface_culled",
+    "triangles_frustum_culled",   "triangles_occlusion_culled",
+    "triangles_rasterized",       "pixels_tested",
+    "depth_passed",               "depth_failed",
+    "shader_invocations",
+};
+
+// 记录线程的序号，按首次记录的先后从0开始编号
+int GetThreadIndex() {
+  static std::atomic<int> thread_num{0};
+  thread_local int index = thread_num.fetch_add(1);
+  return index;
+}
+
+double ToMicroseconds(Profiler::Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+}  // namespace
+
+Profiler::Profiler() : origin_(Clock::now()) {}
+
+Profiler::~Profiler() = default;
+
+Profiler& Profiler::Global() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::Record(Stage stage, int frame, Clock::time_point begin,
+                      Clock::time_point end) {
+  int thread = GetThreadIndex();
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_[frame].seconds[stage] +=
+      std::chrono::duration<double>(end - begin).count();
+  events_.push_back(Event{stage, frame, thread, begin, end});
+}
+
+void Profiler::AddCounter(Counter counter, int frame, long long value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_[frame].counters[counter] += value;
+}
+
+void Profiler::AddRenderStats(int frame,
+                              const PrimitiveAssembler::Stats& assembler,
+                              const Rasterizer::Stats& rasterizer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::array<long long, kCounterNum>& counters = frames_[frame].counters;
+  counters[kTrianglesSubmitted] += assembler.triangles_in;
+  counters[kTrianglesBackfaceCulled] += assembler.backface_culled;
+  counters[kTrianglesFrustumCulled] += assembler.frustum_culled;
+  counters[kTrianglesOcclusionCulled] += rasterizer.triangles_culled;
+  counters[kTrianglesRasterized] +=
+      rasterizer.triangles_submitted - rasterizer.triangles_culled;
+  counters[kPixelsTested] += rasterizer.pixels_tested;
+  counters[kDepthPassed] += rasterizer.depth_passed;
+  counters[kDepthFailed] += rasterizer.depth_failed;
+  // 每个通过深度测试的像素调用一次片元着色器
+  counters[kShaderInvocations] += rasterizer.depth_passed;
+}
+
+void Profiler::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_.clear();
+  events_.clear();
+  origin_ = Clock::now();
+}
+
+bool Profiler::WriteJson(const std::string& filename) const {
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    std::cerr << "Can't open file " << filename << ".\n";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& pair : frames_) {
+    out << "{\"frame\":" << pair.first << ",\"stages_ms\":{";
+    for (int i = 0; i < kStageNum; ++i) {
+      out << (0 < i ? "," : "") << '"' << kStageNames[i]
+          << "\":" << pair.second.seconds[i] * 1000;
+    }
+    out << "},\"counters\":{";
+    for (int i = 0; i < kCounterNum; ++i) {
+      out << (0 < i ? "," : "") << '"' << kCounterNames[i]
+          << "\":" << pair.second.counters[i];
+    }
+    out << "}}\n";
+  }
+  if (!out) {
+    std::cerr << "Can't write file " << filename << ".\n";
+    return false;
+  }
+  return true;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& filename) const {
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    std::cerr << "Can't open file " << filename << ".\n";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  out << "{\"traceEvents\":[";
+  out.setf(std::ios::fixed);
+  out.precision(3);
+  for (std::size_t i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    out << (0 < i ? ",\n" : "\n") << "{\"name\":\""
+        << kStageNames[event.stage] << "\",\"cat\":\"renderer\",\"ph\":\"X\""
+        << ",\"ts\":" << ToMicroseconds(event.begin - origin_)
+        << ",\"dur\":" << ToMicroseconds(event.end - event.begin)
+        << ",\"pid\":0,\"tid\":" << event.thread
+        << ",\"args\":{\"frame\":" << event.frame << "}}";
+  }
+  out << "\n]}\n";
+  if (!out) {
+    std::cerr << "Can't write file " << filename << ".\n";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,618 @@
+#include "include/rasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "include/depth_buffer.h"
+#include "include/geometry.h"
+#include "include/gl.h"
+#include "include/profiler.h"
+#include "include/shader.h"
+#include "include/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// 一行像素的边函数与深度，e与z为该行在x=0处的值
+// E_k(x) = e[k] + a[k]*x, z(x) = z + z_a*x
+struct SpanSetup {
+  double e[3];
+  double a[3];
+  bool top_left[3];
+  double z;
+  double z_a;
+};
+
+// 计算从横坐标dx开始的kSpanWidth个像素的覆盖与深度测试
+// @param zrow span首像素对应的深度缓冲位置
+// @param depth 输出每个像素的插值深度
+// @return 第k位为1表示第k个像素被覆盖且通过深度测试，
+//   第kSpanWidth + k位为1表示第k个像素被覆盖
+using SpanKernel = unsigned (*)(const SpanSetup& span, double dx,
+                                const double* zrow, double* depth);
+
+unsigned SpanKernelScalar(const SpanSetup& span, double dx,
+                          const double* zrow, double* depth) {
+  unsigned mask = 0;
+  unsigned covered = 0;
+  for (int k = 0; k < Rasterizer::kSpanWidth; ++k) {
+    double x = dx + k;
+    bool inside = true;
+    for (int i = 0; i < 3; ++i) {
+      double e = span.e[i] + span.a[i] * x;
+      inside = inside && (0 < e || (0 == e && span.top_left[i]));
+    }
+    depth[k] = span.z + span.z_a * x;
+    if (inside) covered |= 1u << k;
+    if (inside && depth[k] > zrow[k]) mask |= 1u << k;
+  }
+  return mask | covered << Rasterizer::kSpanWidth;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+unsigned SpanKernelSse2(const SpanSetup& span, double dx, const double* zrow,
+                        double* depth) {
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d lane = _mm_set_pd(1, 0);
+  __m128d tl[3];
+  for (int i = 0; i < 3; ++i) {
+    tl[i] = span.top_left[i] ? _mm_castsi128_pd(_mm_set1_epi32(-1)) : zero;
+  }
+  unsigned mask = 0;
+  unsigned covered = 0;
+  for (int k = 0; k < Rasterizer::kSpanWidth; k += 2) {
+    __m128d x = _mm_add_pd(_mm_set1_pd(dx + k), lane);
+    __m128d inside = _mm_castsi128_pd(_mm_set1_epi32(-1));
+    for (int i = 0; i < 3; ++i) {
+      __m128d e = _mm_add_pd(_mm_set1_pd(span.e[i]),
+                             _mm_mul_pd(_mm_set1_pd(span.a[i]), x));
+      __m128d covered = _mm_or_pd(
+          _mm_cmpgt_pd(e, zero), _mm_and_pd(_mm_cmpeq_pd(e, zero), tl[i]));
+      inside = _mm_and_pd(inside, covered);
+    }
+    __m128d z = _mm_add_pd(_mm_set1_pd(span.z),
+                           _mm_mul_pd(_mm_set1_pd(span.z_a), x));
+    __m128d pass = _mm_and_pd(inside, _mm_cmpgt_pd(z, _mm_loadu_pd(zrow + k)));
+    _mm_storeu_pd(depth + k, z);
+    mask |= static_cast<unsigned>(_mm_movemask_pd(pass)) << k;
+    covered |= static_cast<unsigned>(_mm_movemask_pd(inside)) << k;
+  }
+  return mask | covered << Rasterizer::kSpanWidth;
+}
+
+__attribute__((target("avx2"))) unsigned SpanKernelAvx2(
+    const SpanSetup& span, double dx, const double* zrow, double* depth) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d lane = _mm256_set_pd(3, 2, 1, 0);
+  __m256d tl[3];
+  for (int i = 0; i < 3; ++i) {
+    tl[i] = span.top_left[i] ? _mm256_castsi256_pd(_mm256_set1_epi64x(-1))
+                             : zero;
+  }
+  unsigned mask = 0;
+  unsigned covered = 0;
+  for (int k = 0; k < Rasterizer::kSpanWidth; k += 4) {
+    __m256d x = _mm256_add_pd(_mm256_set1_pd(dx + k), lane);
+    __m256d inside = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    for (int i = 0; i < 3; ++i) {
+      __m256d e = _mm256_add_pd(_mm256_set1_pd(span.e[i]),
+                                _mm256_mul_pd(_mm256_set1_pd(span.a[i]), x));
+      __m256d covered =
+          _mm256_or_pd(_mm256_cmp_pd(e, zero, _CMP_GT_OQ),
+                       _mm256_and_pd(_mm256_cmp_pd(e, zero, _CMP_EQ_OQ), tl[i]));
+      inside = _mm256_and_pd(inside, covered);
+    }
+    __m256d z = _mm256_add_pd(_mm256_set1_pd(span.z),
+                              _mm256_mul_pd(_mm256_set1_pd(span.z_a), x));
+    __m256d pass = _mm256_and_pd(
+        inside, _mm256_cmp_pd(z, _mm256_loadu_pd(zrow + k), _CMP_GT_OQ));
+    _mm256_storeu_pd(depth + k, z);
+    mask |= static_cast<unsigned>(_mm256_movemask_pd(pass)) << k;
+    covered |= static_cast<unsigned>(_mm256_movemask_pd(inside)) << k;
+  }
+  return mask | covered << Rasterizer::kSpanWidth;
+}
+#endif
+
+// 定点模式下一行像素的边函数与深度
+// e为该行在x=0处的边函数(已含top-left偏置)，a为x每增加1像素的增量
+struct FixedSpanSetup {
+  std::int64_t e[3];
+  std::int64_t a[3];
+  double z;
+  double z_a;
+};
+
+// 与SpanKernel相同，覆盖测试为整数运算
+using FixedSpanKernel = unsigned (*)(const FixedSpanSetup& span, int x,
+                                     const double* zrow, double* depth);
+
+unsigned FixedSpanKernelScalar(const FixedSpanSetup& span, int x,
+                               const double* zrow, double* depth) {
+  unsigned mask = 0;
+  unsigned covered = 0;
+  for (int k = 0; k < Rasterizer::kSpanWidth; ++k) {
+    bool inside = true;
+    for (int i = 0; i < 3; ++i) {
+      inside = inside && 0 <= span.e[i] + span.a[i] * (x + k);
+    }
+    depth[k] = span.z + span.z_a * static_cast<double>(x + k);
+    if (inside) covered |= 1u << k;
+    if (inside && depth[k] > zrow[k]) mask |= 1u << k;
+  }
+  return mask | covered << Rasterizer::kSpanWidth;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// AVX2没有64位乘法，各通道的初值在标量中算好，之后每4个像素加一次步长
+__attribute__((target("avx2"))) unsigned FixedSpanKernelAvx2(
+    const FixedSpanSetup& span, int x, const double* zrow, double* depth) {
+  const __m256d lane = _mm256_set_pd(3, 2, 1, 0);
+  const __m256i minus_one = _mm256_set1_epi64x(-1);
+  __m256i e[3];
+  __m256i step[3];
+  for (int i = 0; i < 3; ++i) {
+    std::int64_t e0 = span.e[i] + span.a[i] * x;
+    e[i] = _mm256_set_epi64x(e0 + 3 * span.a[i], e0 + 2 * span.a[i],
+                             e0 + span.a[i], e0);
+    step[i] = _mm256_set1_epi64x(4 * span.a[i]);
+  }
+  unsigned mask = 0;
+  unsigned covered = 0;
+  for (int k = 0; k < Rasterizer::kSpanWidth; k += 4) {
+    __m256i inside = minus_one;
+    for (int i = 0; i < 3; ++i) {
+      inside = _mm256_and_si256(inside, _mm256_cmpgt_epi64(e[i], minus_one));
+      e[i] = _mm256_add_epi64(e[i], step[i]);
+    }
+    __m256d xd = _mm256_add_pd(_mm256_set1_pd(x + k), lane);
+    __m256d z = _mm256_add_pd(_mm256_set1_pd(span.z),
+                              _mm256_mul_pd(_mm256_set1_pd(span.z_a), xd));
+    __m256d pass =
+        _mm256_and_pd(_mm256_castsi256_pd(inside),
+                      _mm256_cmp_pd(z, _mm256_loadu_pd(zrow + k), _CMP_GT_OQ));
+    _mm256_storeu_pd(depth + k, z);
+    mask |= static_cast<unsigned>(_mm256_movemask_pd(pass)) << k;
+    covered |= static_cast<unsigned>(
+                   _mm256_movemask_pd(_mm256_castsi256_pd(inside)))
+               << k;
+  }
+  return mask | covered << Rasterizer::kSpanWidth;
+}
+#endif
+
+Rasterizer::SimdLevel DetectSimdLevel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return Rasterizer::kAvx2;
+  if (__builtin_cpu_supports("sse2")) return Rasterizer::kSse2;
+#endif
+  return Rasterizer::kScalar;
+}
+
+SpanKernel GetSpanKernel(Rasterizer::SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (Rasterizer::kAvx2 == level) return SpanKernelAvx2;
+  if (Rasterizer::kSse2 == level) return SpanKernelSse2;
+#endif
+  return SpanKernelScalar;
+}
+
+// SSE2没有64位整数比较，退回到标量实现
+FixedSpanKernel GetFixedSpanKernel(Rasterizer::SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (Rasterizer::kAvx2 == level) return FixedSpanKernelAvx2;
+#endif
+  return FixedSpanKernelScalar;
+}
+
+constexpr double kSubPixelScale = 1 << Rasterizer::kSubPixelBits;
+// 定点模式可表示的最大坐标(像素)。定点坐标小于2^28，边函数与面积的
+// 各项小于2^58，在64位整数中精确计算；但边函数常数项需要约57位有效数字，
+// 超出double的53位，所以定点模式下的覆盖判断都只用整数边函数。
+// 超出范围的三角形按浮点模式光栅化
+constexpr double kMaxFixedCoordinate = 1 << 20;
+
+// 当前线程正在光栅化的tile的深度，DepthBuffer中的紧凑格式解码于此
+thread_local double tile_depth[Rasterizer::kTileSize * Rasterizer::kTileSize];
+}  // namespace
+
+Rasterizer::Rasterizer(int width, int height, ThreadPool* pool,
+                       DepthBuffer::Format depth_format)
+    : width_(width),
+      height_(height),
+      tiles_x_((width + kTileSize - 1) / kTileSize),
+      tiles_y_((height + kTileSize - 1) / kTileSize),
+      pool_(pool),
+      simd_level_(DetectSimdLevel()),
+      precision_mode_(kFloatingPoint),
+      bins_(tiles_x_ * tiles_y_),
+      depth_buffer_(width, height, depth_format),
+      block_zmin_(tiles_x_ * tiles_y_ * kTileBlocks * kTileBlocks),
+      tile_zmin_(tiles_x_ * tiles_y_),
+      tile_stats_(tiles_x_ * tiles_y_),
+      tile_visible_(tiles_x_ * tiles_y_) {
+  Clear();
+}
+
+Rasterizer::~Rasterizer() = default;
+
+void Rasterizer::Clear() {
+  depth_buffer_.Clear();
+  triangles_.clear();
+  setups_.clear();
+  for (auto& bin : bins_) {
+    bin.clear();
+  }
+  stats_ = Stats();
+}
+
+Rasterizer::SimdLevel Rasterizer::GetSimdLevel() const {
+  return simd_level_;
+}
+
+void Rasterizer::SetSimdLevel(SimdLevel level) {
+  simd_level_ = std::min(level, DetectSimdLevel());
+}
+
+Rasterizer::PrecisionMode Rasterizer::GetPrecisionMode() const {
+  return precision_mode_;
+}
+
+void Rasterizer::SetPrecisionMode(PrecisionMode mode) {
+  precision_mode_ = mode;
+}
+
+Rasterizer::Stats Rasterizer::GetStats() const { return stats_; }
+
+void Rasterizer::Submit(const Triangle& triangle) {
+  std::array<Vector4, 3> v = triangle.vertices;
+  TriangleSetup setup;
+  setup.fixed_point = kFixedPoint == precision_mode_;
+  // 定点坐标，单位为1/kSubPixelScale像素
+  std::int64_t fx[3];
+  std::int64_t fy[3];
+  for (int k = 0; k < 3 && setup.fixed_point; ++k) {
+    setup.fixed_point = std::abs(v[k][0]) < kMaxFixedCoordinate &&
+                        std::abs(v[k][1]) < kMaxFixedCoordinate;
+  }
+  if (setup.fixed_point) {
+    // 对齐后的坐标可由double精确表示，但由它们算出的边函数常数项和面积
+    // 可能有舍入误差：退化与绕序由整数面积决定，块与像素的覆盖测试使用
+    // 整数边函数，浮点的边函数只用于深度与重心坐标插值
+    for (int k = 0; k < 3; ++k) {
+      fx[k] = std::llround(v[k][0] * kSubPixelScale);
+      fy[k] = std::llround(v[k][1] * kSubPixelScale);
+      v[k][0] = fx[k] / kSubPixelScale;
+      v[k][1] = fy[k] / kSubPixelScale;
+    }
+  }
+  double xmin = std::floor(std::min(v[0][0], std::min(v[1][0], v[2][0])));
+  double xmax = std::ceil(std::max(v[0][0], std::max(v[1][0], v[2][0])));
+  double ymin = std::floor(std::min(v[0][1], std::min(v[1][1], v[2][1])));
+  double ymax = std::ceil(std::max(v[0][1], std::max(v[1][1], v[2][1])));
+  if (xmax < 0 || ymax < 0 || xmin >= width_ || ymin >= height_) {
+    return;
+  }
+  setup.xmin = std::max(0, static_cast<int>(xmin));
+  setup.xmax = std::min(width_ - 1, static_cast<int>(xmax));
+  setup.ymin = std::max(0, static_cast<int>(ymin));
+  setup.ymax = std::min(height_ - 1, static_cast<int>(ymax));
+
+  // 边k由顶点k+1指向顶点k+2: E_k(p) = (b-a)x(p-a)，在顶点k处取值为2倍面积
+  for (int k = 0; k < 3; ++k) {
+    const Vector4& a = v[(k + 1) % 3];
+    const Vector4& b = v[(k + 2) % 3];
+    setup.edge_a[k] = a[1] - b[1];
+    setup.edge_b[k] = b[0] - a[0];
+    setup.edge_c[k] = a[0] * b[1] - a[1] * b[0];
+  }
+  double area;
+  if (setup.fixed_point) {
+    // 以1/kSubPixelScale^2平方像素为单位的2倍面积，与fixed_c的单位相同
+    std::int64_t fixed_area = (fy[1] - fy[2]) * fx[0] +
+                              (fx[2] - fx[1]) * fy[0] + fx[1] * fy[2] -
+                              fy[1] * fx[2];
+    // check three vertices at one line
+    if (0 == fixed_area) {
+      return;
+    }
+    area = fixed_area / (kSubPixelScale * kSubPixelScale);
+  } else {
+    area = setup.edge_a[0] * v[0][0] + setup.edge_b[0] * v[0][1] +
+           setup.edge_c[0];
+    // check three vertices at one line
+    if (1e-6 > std::abs(area)) {
+      return;
+    }
+  }
+  // 统一方向，使三角形内部边函数为正，两种绕序都能绘制
+  double sign = area < 0 ? -1. : 1.;
+  for (int k = 0; k < 3; ++k) {
+    setup.edge_a[k] *= sign;
+    setup.edge_b[k] *= sign;
+    setup.edge_c[k] *= sign;
+    // 内法线指向+x为左边；水平边内法线指向+y为上边(y轴向上时的底边，
+    // 只要相邻三角形的判定互斥即可)
+    setup.top_left[k] = 0 < setup.edge_a[k] ||
+                        (0 == setup.edge_a[k] && 0 < setup.edge_b[k]);
+  }
+  if (setup.fixed_point) {
+    std::int64_t sign_fixed = area < 0 ? -1 : 1;
+    for (int k = 0; k < 3; ++k) {
+      int a = (k + 1) % 3;
+      int b = (k + 2) % 3;
+      // 像素坐标乘以kSubPixelScale即为定点坐标
+      setup.fixed_a[k] = sign_fixed * (fy[a] - fy[b]) * (1 << kSubPixelBits);
+      setup.fixed_b[k] = sign_fixed * (fx[b] - fx[a]) * (1 << kSubPixelBits);
+      setup.fixed_c[k] = sign_fixed * (fx[a] * fy[b] - fy[a] * fx[b]) -
+                         (setup.top_left[k] ? 0 : 1);
+    }
+  }
+  setup.inv_area = 1. / (area * sign);
+  setup.z_a = 0;
+  setup.z_b = 0;
+  setup.z_c = 0;
+  for (int k = 0; k < 3; ++k) {
+    setup.z_a += setup.edge_a[k] * v[k][2];
+    setup.z_b += setup.edge_b[k] * v[k][2];
+    setup.z_c += setup.edge_c[k] * v[k][2];
+  }
+  setup.z_a *= setup.inv_area;
+  setup.z_b *= setup.inv_area;
+  setup.z_c *= setup.inv_area;
+  setup.z_max = std::max(v[0][2], std::max(v[1][2], v[2][2]));
+
+  int index = static_cast<int>(triangles_.size());
+  triangles_.push_back(triangle);
+  triangles_.back().vertices = v;
+  for (int k = 0; k < 3; ++k) {
+    triangles_.back().barycentric_dx[k] = setup.edge_a[k] * setup.inv_area;
+    triangles_.back().barycentric_dy[k] = setup.edge_b[k] * setup.inv_area;
+  }
+  setups_.push_back(setup);
+  ++stats_.triangles_submitted;
+  for (int ty = setup.ymin / kTileSize; ty <= setup.ymax / kTileSize; ++ty) {
+    for (int tx = setup.xmin / kTileSize; tx <= setup.xmax / kTileSize;
+         ++tx) {
+      bins_[ty * tiles_x_ + tx].push_back(index);
+    }
+  }
+}
+
+template <typename Shader>
+void Rasterizer::Flush(Shader* shader) {
+  std::vector<int> busy_tiles;
+  for (int i = 0; i < static_cast<int>(bins_.size()); ++i) {
+    if (!bins_[i].empty()) busy_tiles.push_back(i);
+  }
+  if (pool_) {
+    pool_->ParallelFor(0, static_cast<int>(busy_tiles.size()),
+                       [this, &busy_tiles, shader](int i) {
+                         RasterizeTile(busy_tiles[i], shader);
+                       });
+  } else {
+    for (int tile : busy_tiles) RasterizeTile(tile, shader);
+  }
+
+  std::vector<bool> visible(triangles_.size(), false);
+  for (int tile : busy_tiles) {
+    stats_.blocks_tested += tile_stats_[tile].blocks_tested;
+    stats_.blocks_culled += tile_stats_[tile].blocks_culled;
+    stats_.pixels_tested += tile_stats_[tile].pixels_tested;
+    stats_.depth_passed += tile_stats_[tile].depth_passed;
+    stats_.depth_failed += tile_stats_[tile].depth_failed;
+    for (int index : tile_visible_[tile]) {
+      visible[index] = true;
+    }
+  }
+  stats_.triangles_culled += std::count(visible.begin(), visible.end(), false);
+  triangles_.clear();
+  setups_.clear();
+  for (auto& bin : bins_) {
+    bin.clear();
+  }
+}
+
+template <typename Shader>
+void Rasterizer::RasterizeTile(int tile_index, Shader* shader) {
+  Stats& stats = tile_stats_[tile_index];
+  std::vector<int>& visible = tile_visible_[tile_index];
+  stats = Stats();
+  visible.clear();
+  double* zbuffer = tile_depth;
+  bool cleared = depth_buffer_.IsTileCleared(tile_index);
+  depth_buffer_.LoadTile(tile_index, zbuffer);
+  double* block_zmin =
+      block_zmin_.data() + tile_index * kTileBlocks * kTileBlocks;
+  int tile_x = tile_index % tiles_x_ * kTileSize;
+  int tile_y = tile_index / tiles_x_ * kTileSize;
+  for (int block = 0; block < kTileBlocks * kTileBlocks; ++block) {
+    bool on_screen = tile_x + block % kTileBlocks * kBlockSize < width_ &&
+                     tile_y + block / kTileBlocks * kBlockSize < height_;
+    if (!on_screen) {
+      block_zmin[block] = std::numeric_limits<double>::max();
+    } else if (cleared) {
+      block_zmin[block] = DepthBuffer::kClearDepth;
+    } else {
+      UpdateBlockDepth(tile_index, block, zbuffer);
+    }
+  }
+  tile_zmin_[tile_index] =
+      *std::min_element(block_zmin, block_zmin + kTileBlocks * kTileBlocks);
+
+  for (int index : bins_[tile_index]) {
+    if (RasterizeTriangle(triangles_[index], setups_[index], tile_index,
+                          zbuffer, shader, &stats)) {
+      visible.push_back(index);
+    }
+  }
+  depth_buffer_.StoreTile(tile_index, zbuffer);
+}
+
+template <typename Shader>
+bool Rasterizer::RasterizeTriangle(const Triangle& triangle,
+                                   const TriangleSetup& setup, int tile_index,
+                                   double* zbuffer, Shader* shader,
+                                   Stats* stats) {
+  // 平面方程在块角点处与逐像素计算的舍入不同，剔除时留出余量
+  constexpr double kDepthEpsilon = 1e-9;
+  if (setup.z_max + kDepthEpsilon <= tile_zmin_[tile_index]) {
+    return false;
+  }
+  int tile_x = tile_index % tiles_x_ * kTileSize;
+  int tile_y = tile_index / tiles_x_ * kTileSize;
+  int xmin = std::max(setup.xmin, tile_x);
+  int xmax = std::min(setup.xmax, tile_x + kTileSize - 1);
+  int ymin = std::max(setup.ymin, tile_y);
+  int ymax = std::min(setup.ymax, tile_y + kTileSize - 1);
+  double* block_zmin =
+      block_zmin_.data() + tile_index * kTileBlocks * kTileBlocks;
+  SpanKernel kernel = GetSpanKernel(simd_level_);
+  FixedSpanKernel fixed_kernel = GetFixedSpanKernel(simd_level_);
+  // 像素计数只在统计开启时进行，关闭时span循环中只多一次分支
+  const bool count_pixels = Profiler::Global().IsEnabled();
+
+  bool tested = false;
+  bool occluded = true;
+  bool tile_dirty = false;
+  double depth[kSpanWidth];
+  SpanSetup span;
+  FixedSpanSetup fixed_span;
+  span.z_a = setup.z_a;
+  fixed_span.z_a = setup.z_a;
+  for (int k = 0; k < 3; ++k) {
+    span.a[k] = setup.edge_a[k];
+    span.top_left[k] = setup.top_left[k];
+    fixed_span.a[k] = setup.fixed_a[k];
+  }
+  for (int by = (ymin - tile_y) / kBlockSize;
+       by <= (ymax - tile_y) / kBlockSize; ++by) {
+    int y0 = std::max(ymin, tile_y + by * kBlockSize);
+    int y1 = std::min(ymax, tile_y + by * kBlockSize + kBlockSize - 1);
+    for (int bx = (xmin - tile_x) / kBlockSize;
+         bx <= (xmax - tile_x) / kBlockSize; ++bx) {
+      // x为块(span)首像素，[x0,x1]为块内需要光栅化的范围
+      int x = tile_x + bx * kBlockSize;
+      int x0 = std::max(xmin, x);
+      int x1 = std::min(xmax, x + kBlockSize - 1);
+      // 线性函数在矩形上的极值位于角点：
+      // 任一边函数在四个角点都为负，三角形不覆盖该块。
+      // 定点模式下与span的覆盖测试一样使用整数边函数，结果精确
+      bool outside = false;
+      for (int k = 0; k < 3 && !outside; ++k) {
+        if (setup.fixed_point) {
+          std::int64_t e00 = setup.fixed_a[k] * x0 + setup.fixed_b[k] * y0 +
+                             setup.fixed_c[k];
+          std::int64_t dx = setup.fixed_a[k] * (x1 - x0);
+          std::int64_t dy = setup.fixed_b[k] * (y1 - y0);
+          outside = std::max(std::max(e00, e00 + dx),
+                             std::max(e00 + dy, e00 + dx + dy)) < 0;
+        } else {
+          double e00 = setup.edge_a[k] * x0 + setup.edge_b[k] * y0 +
+                       setup.edge_c[k];
+          double dx = setup.edge_a[k] * (x1 - x0);
+          double dy = setup.edge_b[k] * (y1 - y0);
+          outside = std::max(std::max(e00, e00 + dx),
+                             std::max(e00 + dy, e00 + dx + dy)) < 0;
+        }
+      }
+      if (outside) continue;
+      ++stats->blocks_tested;
+      tested = true;
+      double z00 = setup.z_a * x0 + setup.z_b * y0 + setup.z_c;
+      double zdx = setup.z_a * (x1 - x0);
+      double zdy = setup.z_b * (y1 - y0);
+      double block_zmax = std::min(
+          setup.z_max, std::max(std::max(z00, z00 + zdx),
+                                std::max(z00 + zdy, z00 + zdx + zdy)));
+      int block_index = by * kTileBlocks + bx;
+      if (block_zmax + kDepthEpsilon <= block_zmin[block_index]) {
+        ++stats->blocks_culled;
+        continue;
+      }
+      occluded = false;
+
+      // 只有覆盖了块内最远深度的像素时块的最小值才可能改变
+      bool block_dirty = false;
+      // 块内不需要的像素
+      unsigned range = (~0u << (x0 - x)) & ((1u << (x1 - x + 1)) - 1);
+      for (int j = y0; j <= y1; ++j) {
+        double* zrow = zbuffer + (j - tile_y) * kTileSize - tile_x;
+        for (int k = 0; k < 3; ++k) {
+          span.e[k] = setup.edge_b[k] * j + setup.edge_c[k];
+        }
+        span.z = setup.z_b * j + setup.z_c;
+        unsigned result = 0;
+        if (setup.fixed_point) {
+          for (int k = 0; k < 3; ++k) {
+            fixed_span.e[k] = setup.fixed_b[k] * j + setup.fixed_c[k];
+          }
+          fixed_span.z = span.z;
+          result = fixed_kernel(fixed_span, x, zrow + x, depth);
+        } else {
+          result = kernel(span, x, zrow + x, depth);
+        }
+        unsigned mask = result & range;
+        if (count_pixels) {
+          int covered = __builtin_popcount(result >> kSpanWidth & range);
+          int passed = __builtin_popcount(mask);
+          stats->pixels_tested += covered;
+          stats->depth_passed += passed;
+          stats->depth_failed += covered - passed;
+        }
+        while (mask) {
+          int k = __builtin_ctz(mask);
+          mask &= mask - 1;
+          int i = x + k;
+          block_dirty = block_dirty || zrow[i] == block_zmin[block_index];
+          zrow[i] = depth[k];
+          Vector3 barycentric{(span.e[0] + span.a[0] * i) * setup.inv_area,
+                              (span.e[1] + span.a[1] * i) * setup.inv_area,
+                              (span.e[2] + span.a[2] * i) * setup.inv_area};
+          shader->fragment_process(Vector2Int{i, j}, barycentric, triangle);
+        }
+      }
+      if (block_dirty) {
+        // 同理，只有原先等于tile最小值的块变化时才需要重算tile
+        tile_dirty =
+            tile_dirty || block_zmin[block_index] == tile_zmin_[tile_index];
+        UpdateBlockDepth(tile_index, block_index, zbuffer);
+      }
+    }
+  }
+  if (tile_dirty) {
+    tile_zmin_[tile_index] = *std::min_element(
+        block_zmin, block_zmin + kTileBlocks * kTileBlocks);
+  }
+  return !(tested && occluded);
+}
+
+void Rasterizer::UpdateBlockDepth(int tile_index, int block_index,
+                                  const double* zbuffer) {
+  int x = block_index % kTileBlocks * kBlockSize;
+  int y = block_index / kTileBlocks * kBlockSize;
+  int block_width = std::min(kBlockSize, width_ - tile_index % tiles_x_ *
+                                                      kTileSize - x);
+  int block_height = std::min(kBlockSize, height_ - tile_index / tiles_x_ *
+                                                        kTileSize - y);
+  const double* block = zbuffer + y * kTileSize + x;
+  double zmin = std::numeric_limits<double>::max();
+  // 块未填满时最小值必然是清屏值，可以提前结束
+  for (int j = 0; j < block_height && DepthBuffer::kClearDepth != zmin; ++j) {
+    for (int i = 0; i < block_width; ++i) {
+      zmin = std::min(zmin, block[j * kTileSize + i]);
+    }
+  }
+  block_zmin_[tile_index * kTileBlocks * kTileBlocks + block_index] = zmin;
+}
+
+template void Rasterizer::Flush<IShader>(IShader* shader);
+template void Rasterizer::Flush<TextureShader>(TextureShader* shader);
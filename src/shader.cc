@@ -0,0 +1,51 @@
+#include "include/shader.h"
+
+#include <cmath>
+#include <string>
+
+#include "include/framebuffer.h"
+#include "include/geometry.h"
+#include "include/gl.h"
+#include "include/texture.h"
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+TextureShader::TextureShader(const std::string& texture_file)
+    : TextureShader(nullptr) {
+  owned_texture_ = LoadTexture(texture_file, &ThreadPool::Global());
+  texture_ = &owned_texture_;
+}
+TextureShader::TextureShader(const Texture* texture) : texture_(texture) {
+  m_camera_ = matrix_m::IMatrix4();
+  m_proj_ = matrix_m::IMatrix4();
+  m_mvp_ = matrix_m::IMatrix4();
+}
+TextureShader::~TextureShader() {
+  canvas_ptr_ = nullptr;
+}
+Vector4 TextureShader::vertex_process(const Vector4& vertex) {
+  // printf("x:%f, y:%f, z:%f, w:%f\n", vertex[0], vertex[1], vertex[2],
+  //        vertex[3]);
+  return m_mvp_ * vertex;
+}
+void TextureShader::LookAt(const Vector3& camera_pos,
+                           const Vector3& gaze_direction,
+                           const Vector3& viewup) {
+  m_camera_ = CameraTransM(camera_pos, gaze_direction, viewup);
+  m_mvp_ = m_proj_ * m_camera_;
+}
+
+void TextureShader::Projection(const double near) {
+  m_proj_ = ProjectionM(-1, 1, -1, 1, -5, -1, true);
+  m_mvp_ = m_proj_ * m_camera_;
+}
+
+SMatrix4 TextureShader::GetMvp() const { return m_mvp_; }
+
+const Texture& TextureShader::GetTexture() const { return *texture_; }
+
+void TextureShader::RegisterCanvas(ColorBuffer* canvas_ptr) {
+  canvas_ptr_ = canvas_ptr;
+}
+
+void TextureShader::UnregisterCanvas() { canvas_ptr_ = nullptr; }
@@ -0,0 +1,98 @@
+#include "include/texture.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+Texture::Level::Level(int level_width, int level_height)
+    : width(level_width),
+      height(level_height),
+      blocks_x((level_width + kBlockSize - 1) / kBlockSize) {
+  blocks.resize(blocks_x * ((level_height + kBlockSize - 1) / kBlockSize));
+}
+
+// 空纹理只有一个白色纹素，与TgaImage::GetColor越界时的返回值一致
+Texture::Texture() : levels_(1, Level(1, 1)) {
+  levels_[0].At(0, 0) = 0xFFFFFFFF;
+}
+
+Texture::Texture(const TgaImage& image) : Texture() {
+  int width = image.GetWidth();
+  int height = image.GetHeight();
+  if (0 >= width || 0 >= height) return;
+  levels_[0] = Level(width, height);
+  int bytespp = image.GetBytespp();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      TgaColor color = image.GetColor(x, y);
+      std::uint8_t b = color.b;
+      std::uint8_t g = color.g;
+      std::uint8_t r = color.r;
+      std::uint8_t a = color.a;
+      if (TgaImage::kGrayscale == bytespp) {
+        g = r = b;
+        a = 255;
+      } else if (TgaImage::kRGB == bytespp) {
+        a = 255;
+      }
+      levels_[0].At(x, y) = static_cast<std::uint32_t>(b) |
+                            static_cast<std::uint32_t>(g) << 8 |
+                            static_cast<std::uint32_t>(r) << 16 |
+                            static_cast<std::uint32_t>(a) << 24;
+    }
+  }
+}
+
+Texture::~Texture() = default;
+
+void Texture::GenerateMipmaps(ThreadPool* pool) {
+  levels_.resize(1);
+  while (1 < levels_.back().width || 1 < levels_.back().height) {
+    const Level& src = levels_.back();
+    Level dst(std::max(1, src.width / 2), std::max(1, src.height / 2));
+    // 一次处理一行块，不同任务写入的纹素互不重叠
+    int block_rows = (dst.height + kBlockSize - 1) / kBlockSize;
+    auto downsample = [&src, &dst](int block_row) {
+      const std::uint32_t kMask = 0x00FF00FF;
+      int y_end = std::min(dst.height, (block_row + 1) * kBlockSize);
+      for (int y = block_row * kBlockSize; y < y_end; ++y) {
+        // 奇数尺寸时最后一行/列与自身平均
+        int y0 = std::min(2 * y, src.height - 1);
+        int y1 = std::min(2 * y + 1, src.height - 1);
+        for (int x = 0; x < dst.width; ++x) {
+          int x0 = std::min(2 * x, src.width - 1);
+          int x1 = std::min(2 * x + 1, src.width - 1);
+          std::uint32_t c[4] = {src.At(x0, y0), src.At(x1, y0),
+                                src.At(x0, y1), src.At(x1, y1)};
+          // 每个16位槽累加4个8位值不会溢出
+          std::uint32_t rb = 0x00020002;
+          std::uint32_t ga = 0x00020002;
+          for (int i = 0; i < 4; ++i) {
+            rb += c[i] & kMask;
+            ga += c[i] >> 8 & kMask;
+          }
+          dst.At(x, y) = (rb >> 2 & kMask) | (ga >> 2 & kMask) << 8;
+        }
+      }
+    };
+    if (pool) {
+      pool->ParallelFor(0, block_rows, downsample);
+    } else {
+      for (int i = 0; i < block_rows; ++i) downsample(i);
+    }
+    levels_.push_back(std::move(dst));
+  }
+}
+
+Texture LoadTexture(const std::string& filename, ThreadPool* pool) {
+  TgaImage image;
+  image.ReadTgaFile(filename);
+  Texture texture(image);
+  texture.GenerateMipmaps(pool);
+  texture.SetFilterMode(Texture::kTrilinear);
+  return texture;
+}
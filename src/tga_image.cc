@@ -1,9 +1,274 @@
 #include "include/tga_image.h"
 
+#include <limits.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
+
+#include "include/file_io.h"
+#include "include/mapped_file.h"
+#include "include/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// TGA 2.0注脚：两个4字节偏移量加18字节签名
+const int kFooterSize = 26;
+const char kFooterSignature[] = "TRUEVISION-XFILE.";
+
+// 重复包的像素模式：48是1、2、3、4字节像素大小的公倍数，
+// 按16字节一组写入时每组的内容固定
+const int kFillPatternSize = 48;
+
+// 把一个像素重复写满dst开始的length字节，length为bytespp的整数倍
+void FillPixels(const std::uint8_t* pixel, int bytespp, std::size_t length,
+                std::uint8_t* dst) {
+  // 短的重复包逐像素复制，省去构造模式的开销
+  if (length < kFillPatternSize) {
+    for (std::size_t i = 0; i < length; i += bytespp) {
+      if (3 == bytespp) {
+        std::memcpy(dst + i, pixel, 3);
+      } else if (4 == bytespp) {
+        std::memcpy(dst + i, pixel, 4);
+      } else {
+        std::memcpy(dst + i, pixel, bytespp);
+      }
+    }
+    return;
+  }
+  std::uint8_t pattern[kFillPatternSize];
+  for (int i = 0; i < kFillPatternSize; i += bytespp) {
+    std::memcpy(pattern + i, pixel, bytespp);
+  }
+  std::size_t i = 0;
+#ifdef __SSE2__
+  __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+  __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + 16));
+  __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + 32));
+  for (; i + kFillPatternSize <= length; i += kFillPatternSize) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), v1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), v2);
+  }
+#endif
+  for (; i < length; i += kFillPatternSize) {
+    std::memcpy(dst + i, pattern,
+                std::min<std::size_t>(kFillPatternSize, length - i));
+  }
+}
+
+// 把一行像素的顺序原地反转
+using ReverseRowFunc = void (*)(std::uint8_t* row, int width, int bytespp);
+
+// 反转[begin, end)之间的像素
+void ReversePixels(std::uint8_t* row, int begin, int end, int bytespp) {
+  for (int i = begin, j = end - 1; i < j; ++i, --j) {
+    std::swap_ranges(row + i * bytespp, row + (i + 1) * bytespp,
+                     row + j * bytespp);
+  }
+}
+
+void ReverseRowScalar(std::uint8_t* row, int width, int bytespp) {
+  if (4 == bytespp) {
+    // 4字节像素整体交换
+    std::uint32_t* pixels = reinterpret_cast<std::uint32_t*>(row);
+    std::reverse(pixels, pixels + width);
+  } else if (1 == bytespp) {
+    std::reverse(row, row + width);
+  } else {
+    ReversePixels(row, 0, width, bytespp);
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 从行的两端各取一组16字节的像素，组内用字节重排反转后交换位置，
+// 剩下不足两组的中间部分逐像素处理
+__attribute__((target("ssse3"))) void ReverseRowSsse3(std::uint8_t* row,
+                                                      int width,
+                                                      int bytespp) {
+  int group = 16 / bytespp;
+  const __m128i shuffle =
+      1 == bytespp ? _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4,
+                                   3, 2, 1, 0)
+                   : _mm_setr_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7,
+                                   0, 1, 2, 3);
+  int i = 0;
+  for (; 2 * (i + group) <= width; i += group) {
+    __m128i* left = reinterpret_cast<__m128i*>(row + i * bytespp);
+    __m128i* right =
+        reinterpret_cast<__m128i*>(row + (width - i - group) * bytespp);
+    __m128i a = _mm_loadu_si128(left);
+    __m128i b = _mm_loadu_si128(right);
+    _mm_storeu_si128(left, _mm_shuffle_epi8(b, shuffle));
+    _mm_storeu_si128(right, _mm_shuffle_epi8(a, shuffle));
+  }
+  ReversePixels(row, i, width - i, bytespp);
+}
+
+// 3字节像素每组5个像素15字节。左组从组首读16字节，右组从组首前一字节
+// 读16字节，都不越过行的边界；写回时组外的那个字节保持原值。
+// 两组之间至少隔一个像素，组外的字节不会属于另一组
+__attribute__((target("ssse3"))) void ReverseRowRgbSsse3(std::uint8_t* row,
+                                                         int width,
+                                                         int bytespp) {
+  const int kGroup = 5;
+  // 右组的5个像素反转后放到字节0..14，-128对应的字节置0
+  const __m128i to_left = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4,
+                                        5, 6, 1, 2, 3, -128);
+  // 左组的5个像素反转后放到字节1..15
+  const __m128i to_right = _mm_setr_epi8(-128, 12, 13, 14, 9, 10, 11, 6, 7,
+                                         8, 3, 4, 5, 0, 1, 2);
+  const __m128i last_byte = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                          0, 0, 0, -1);
+  const __m128i first_byte = _mm_setr_epi8(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                           0, 0, 0, 0, 0);
+  int i = 0;
+  for (; 2 * (i + kGroup) < width; i += kGroup) {
+    __m128i* left = reinterpret_cast<__m128i*>(row + i * bytespp);
+    __m128i* right =
+        reinterpret_cast<__m128i*>(row + (width - i - kGroup) * bytespp - 1);
+    __m128i a = _mm_loadu_si128(left);
+    __m128i b = _mm_loadu_si128(right);
+    _mm_storeu_si128(left, _mm_or_si128(_mm_shuffle_epi8(b, to_left),
+                                        _mm_and_si128(a, last_byte)));
+    _mm_storeu_si128(right, _mm_or_si128(_mm_shuffle_epi8(a, to_right),
+                                         _mm_and_si128(b, first_byte)));
+  }
+  ReversePixels(row, i, width - i, bytespp);
+}
+#endif
+
+ReverseRowFunc GetReverseRowFunc(int bytespp) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("ssse3")) {
+    if (1 == bytespp || 4 == bytespp) return ReverseRowSsse3;
+    if (3 == bytespp) return ReverseRowRgbSsse3;
+  }
+#endif
+  return ReverseRowScalar;
+}
+
+// 一个RLE包最多包含的像素数
+const int kMaxPacketPixels = 128;
+// 每个行带一个iovec，再加上header与注脚各一个，行带数不超过该值时
+// 整个文件可以由一次writev提交(IOV_MAX，POSIX只保证至少为16)
+const int kMaxBands = IOV_MAX - 2;
+
+// 计算一行中相邻像素是否相同：eq中第i位为1表示第i个与第i+1个像素相同，
+// i < width - 1，其余位为0
+using EqualMaskFunc = void (*)(const std::uint8_t* row, int width,
+                               int bytespp, std::uint64_t* eq);
+
+void EqualMaskScalar(const std::uint8_t* row, int width, int bytespp,
+                     std::uint64_t* eq, int begin) {
+  for (int i = begin; i + 1 < width; ++i) {
+    const std::uint8_t* p = row + i * bytespp;
+    if (0 == std::memcmp(p, p + bytespp, bytespp)) {
+      eq[i >> 6] |= std::uint64_t{1} << (i & 63);
+    }
+  }
+}
+
+void EqualMaskScalar(const std::uint8_t* row, int width, int bytespp,
+                     std::uint64_t* eq) {
+  std::fill(eq, eq + (width + 63) / 64, 0);
+  EqualMaskScalar(row, width, bytespp, eq, 0);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 以32字节为单位比较该行与错开一个像素的自身，再把逐字节的比较结果
+// 归并为逐像素的结果；每组像素数(8或32)整除64，一组的位不跨越eq的字
+__attribute__((target("avx2,bmi2"))) void EqualMaskAvx2(
+    const std::uint8_t* row, int width, int bytespp, std::uint64_t* eq) {
+  std::fill(eq, eq + (width + 63) / 64, 0);
+  // 一组的像素数，两次加载都不越过行尾时才用SIMD
+  int group = 3 == bytespp ? 8 : 32 / bytespp;
+  int i = 0;
+  for (; (i + 1) * bytespp + 32 <= width * bytespp; i += group) {
+    const std::uint8_t* p = row + i * bytespp;
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + bytespp));
+    std::uint32_t bits = 0;
+    if (4 == bytespp) {
+      bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+    } else {
+      std::uint32_t m =
+          static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+      if (1 == bytespp) {
+        bits = m;
+      } else {
+        // 第3k、3k+1、3k+2字节都相同时第k个像素与下一个相同
+        bits = _pext_u32(m & m >> 1 & m >> 2, 0x00249249u);
+      }
+    }
+    eq[i >> 6] |= static_cast<std::uint64_t>(bits) << (i & 63);
+  }
+  EqualMaskScalar(row, width, bytespp, eq, i);
+}
+#endif
+
+EqualMaskFunc GetEqualMaskFunc(int bytespp) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if ((1 == bytespp || 3 == bytespp || 4 == bytespp) &&
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+    return EqualMaskAvx2;
+  }
+#endif
+  return EqualMaskScalar;
+}
+
+// eq中[from, limit)内第一个值为value的位，没有时返回limit
+int FindBit(const std::uint64_t* eq, int from, int limit, bool value) {
+  for (int i = from; i < limit; i = (i | 63) + 1) {
+    std::uint64_t word = value ? eq[i >> 6] : ~eq[i >> 6];
+    word >>= i & 63;
+    if (word) return std::min(limit, i + __builtin_ctzll(word));
+  }
+  return limit;
+}
+
+// 把一行像素编码为RLE包追加到out之后，包不跨行。
+// 两个及以上相同像素组成重复包(最高位为1，之后一个像素)，
+// 其余像素组成原始包(之后count个像素)，包头低7位为像素数减1
+void EncodeRow(const std::uint8_t* row, int width, int bytespp,
+               const std::uint64_t* eq, std::vector<std::uint8_t>* out) {
+  int i = 0;
+  while (i < width) {
+    bool run = i + 1 < width && (eq[i >> 6] >> (i & 63) & 1);
+    if (run) {
+      // 重复到第一个与下一个像素不同的像素为止(含)
+      int end = FindBit(eq, i, width - 1, false) + 1;
+      for (; i < end;) {
+        int n = std::min(kMaxPacketPixels, end - i);
+        out->push_back(static_cast<std::uint8_t>(0x80 | (n - 1)));
+        out->insert(out->end(), row + i * bytespp, row + (i + 1) * bytespp);
+        i += n;
+      }
+    } else {
+      // 原始像素到下一段重复之前为止
+      int next = FindBit(eq, i, width - 1, true);
+      int end = next < width - 1 ? next : width;
+      for (; i < end;) {
+        int n = std::min(kMaxPacketPixels, end - i);
+        out->push_back(static_cast<std::uint8_t>(n - 1));
+        out->insert(out->end(), row + i * bytespp, row + (i + n) * bytespp);
+        i += n;
+      }
+    }
+  }
+}
+}  // namespace
 
 TgaImage::TgaImage() : width_(0), height_(0), bytespp_(0) {}
 TgaImage::TgaImage(int width, int height, int bytespp)
@@ -12,63 +277,80 @@ TgaImage::TgaImage(int width, int height, int bytespp)
       height_(height),
       bytespp_(bytespp) {}
 TgaImage::TgaImage(const TgaImage& image) = default;
+TgaImage& TgaImage::operator=(const TgaImage& rhs) = default;
 TgaImage::~TgaImage() = default;
 
+void TgaImage::Reset(int width, int height, int bytespp) {
+  data_.resize(static_cast<std::size_t>(width) * height * bytespp);
+  width_ = width;
+  height_ = height;
+  bytespp_ = bytespp;
+  stored_flip_horizontal_ = false;
+  stored_flip_vertical_ = false;
+}
+
 int TgaImage::GetWidth() const { return width_; }
 
 int TgaImage::GetHeight() const { return height_; }
 
 int TgaImage::GetBytespp() const { return bytespp_; }
 
-bool TgaImage::ReadTgaFile(const std::string& filename) {
-  std::ifstream in;
-  const char* cfilename = filename.c_str();
-  in.open(cfilename, std::ios::in | std::ios::binary);
-  if (!in.is_open()) {
-    in.close();
-    std::cerr << "Can't open file " << filename << ".\n";
-    return false;
-  }
+std::uint8_t* TgaImage::GetData() { return data_.data(); }
+
+const std::uint8_t* TgaImage::GetData() const { return data_.data(); }
+
+bool TgaImage::GetStoredFlipHorizontal() const {
+  return stored_flip_horizontal_;
+}
+
+bool TgaImage::GetStoredFlipVertical() const { return stored_flip_vertical_; }
+
+bool TgaImage::ReadTgaFile(const std::string& filename,
+                           bool resolve_orientation) {
+  // 整个文件映射到内存，头部与像素数据都直接从映射中读取
+  MappedFile file;
+  if (!file.Open(filename)) return false;
+  const std::uint8_t* begin = file.GetData();
+  const std::uint8_t* end = begin + file.GetSize();
   TgaHeader header;
-  in.read(reinterpret_cast<char*>(&header), sizeof(header));
-  if (!in.good()) {
-    in.close();
+  if (file.GetSize() < sizeof(header)) {
     std::cerr << "An error occurred while reading header of file.\n";
     return false;
   }
+  std::memcpy(&header, begin, sizeof(header));
   width_ = static_cast<int>(header.image_width);
   height_ = static_cast<int>(header.image_height);
   bytespp_ = static_cast<int>(header.bits_per_pixel >> 3);
   if (width_ <= 0) {
-    in.close();
     std::cerr << "Non-positive value of width: " << width_ << ".\n";
     return false;
   }
   if (height_ <= 0) {
-    in.close();
     std::cerr << "Non-positive value of height: " << height_ << ".\n";
     return false;
   }
   if (bytespp_ != kGrayscale && bytespp_ != kRGB && bytespp_ != kRGBA) {
-    in.close();
     std::cerr << "Unknown format. Bytes per pixel is: " << bytespp_ << ".\n";
     return false;
   }
-  std::size_t bytes_num = width_ * height_ * bytespp_;
-  data_ = std::vector<std::uint8_t>(bytes_num, 0);
+  std::size_t bytes_num =
+      static_cast<std::size_t>(width_) * height_ * bytespp_;
+  // 像素数据位于header与可选的图像ID字段之后
+  std::size_t offset = sizeof(header) + header.id_field_length;
+  const std::uint8_t* pixels = begin + std::min(offset, file.GetSize());
   int image_type = static_cast<int>(header.image_data_type);
   if (3 == image_type || 2 == image_type) {
-    in.read(reinterpret_cast<char*>(data_.data()), bytes_num);
-    if (!in.good()) {
-      in.close();
+    if (static_cast<std::size_t>(end - pixels) < bytes_num) {
       std::cerr << "An error occurred while reading image data in file.\n";
       return false;
     }
+    data_.assign(pixels, pixels + bytes_num);
   } else if (10 == image_type || 11 == image_type) {
     std::cerr << "The file uses RLE compression.\n";
-    DecompressRLE(in, bytes_num, bytespp_);
+    if (!DecompressRLE(pixels, end - pixels, bytes_num, bytespp_)) {
+      return false;
+    }
   } else {
-    in.close();
     if (1 == image_type || 9 == image_type) {
       std::cerr << "The data is color-mapped image.\n";
     } else if (0 == image_type) {
@@ -78,9 +360,9 @@ bool TgaImage::ReadTgaFile(const std::string& filename) {
     }
     return false;
   }
-  if (header.image_descriptor & (1 << 4)) FlipHorizontally();
-  if (header.image_descriptor & (1 << 5)) FlipVertically();
-  in.close();
+  stored_flip_horizontal_ = header.image_descriptor & (1 << 4);
+  stored_flip_vertical_ = header.image_descriptor & (1 << 5);
+  if (resolve_orientation) ResolveOrientation();
   std::cerr << width_ << "x" << height_ << ", bytespp: " << bytespp_ << ".\n";
   return true;
 }
@@ -98,17 +380,8 @@ bool TgaImage::ReadTgaFile(const std::string& filename) {
 // @param horizontal_flip 是否水平反转
 // @param rle 是否使用行程长度压缩
 bool TgaImage::WriteTgaFile(const std::string& filename, bool horizontal_flip,
-                            bool vertical_flip, bool rle) const {
-  std::uint32_t extension_area_offset = 0;
-  std::uint32_t dev_area_offset = 0;
-  std::string footer_signature("TRUEVISION-XFILE.");
-  std::ofstream out;
-  out.open(filename.c_str(), std::ios::trunc | std::ios::binary);
-  if (!out.is_open()) {
-    out.close();
-    std::cerr << "Can't open file " << filename << ".\n";
-    return false;
-  }
+                            bool vertical_flip, bool rle,
+                            ThreadPool* pool) const {
   TgaHeader header;
   header.image_data_type =
       (bytespp_ == kGrayscale ? (rle ? 11 : 3) : (rle ? 10 : 2));
@@ -116,105 +389,153 @@ bool TgaImage::WriteTgaFile(const std::string& filename, bool horizontal_flip,
   header.image_height = height_;
   header.bits_per_pixel = bytespp_ << 3;
   std::uint8_t descriptor = 0;
-  if (horizontal_flip) descriptor |= (1 << 4);
-  if (vertical_flip) descriptor |= (1 << 5);
+  if (horizontal_flip != stored_flip_horizontal_) descriptor |= (1 << 4);
+  if (vertical_flip != stored_flip_vertical_) descriptor |= (1 << 5);
   header.image_descriptor = descriptor;
-  out.write(reinterpret_cast<char*>(&header), sizeof(header));
-  if (!out.good()) {
-    out.close();
-    std::cerr << "An error occurred while writing header in file.\n";
-    return false;
-  }
+  // 拓展区偏移量与开发者数据区偏移量均为0，之后是含结尾\0的签名
+  std::uint8_t footer[kFooterSize] = {};
+  std::memcpy(footer + 8, kFooterSignature, sizeof(kFooterSignature));
+
+  // RLE按行带分别编码，各行带的结果不拼接，直接作为各自的iovec
+  std::vector<std::vector<std::uint8_t>> bands;
+  if (rle) bands = EncodeRle(pool);
+  // header、图像数据、注脚由一次系统调用写出
+  std::vector<iovec> iov;
+  iov.push_back(iovec{&header, sizeof(header)});
   if (!rle) {
-    out.write(reinterpret_cast<const char*>(data_.data()),
-              width_ * height_ * bytespp_);
-    if (!out.good()) {
-      out.close();
-      std::cerr << "An error occurred while writing image data in file.\n";
-      return false;
-    }
+    iov.push_back(
+        iovec{const_cast<std::uint8_t*>(data_.data()), data_.size()});
   } else {
-    // rle
-  }
-  out.write(reinterpret_cast<char*>(&extension_area_offset),
-            sizeof(extension_area_offset));
-  if (!out.good()) {
-    out.close();
-    std::cerr
-        << "An error occurred while writing extension area offset in file.\n";
-    return false;
-  }
-  out.write(reinterpret_cast<char*>(&dev_area_offset), sizeof(dev_area_offset));
-  if (!out.good()) {
-    out.close();
-    std::cerr
-        << "An error occurred while writing developer area offset in file.\n";
-    return false;
-  }
-  out.write(footer_signature.c_str(), sizeof(footer_signature));
-  if (!out.good()) {
-    out.close();
-    std::cerr << "An error occurred while writing signature in file.\n";
-    return false;
+    for (std::vector<std::uint8_t>& band : bands) {
+      iov.push_back(iovec{band.data(), band.size()});
+    }
   }
-  out.close();
-  return true;
+  iov.push_back(iovec{footer, sizeof(footer)});
+  return WriteFile(filename, &iov);
+}
+
+std::vector<std::vector<std::uint8_t>> TgaImage::EncodeRle(
+    ThreadPool* pool) const {
+  static const EqualMaskFunc kEqualMask[5] = {
+      nullptr, GetEqualMaskFunc(1), GetEqualMaskFunc(2), GetEqualMaskFunc(3),
+      GetEqualMaskFunc(4)};
+  int band_num = GetRowBandNum(height_, data_.size(), pool, 1, kMaxBands);
+  std::vector<std::vector<std::uint8_t>> bands(band_num);
+  ForEachRowBand(
+      height_, band_num, pool, [this, &bands](int band, int begin, int end) {
+        std::vector<std::uint8_t>& out = bands[band];
+        // 最坏情况下每128个像素多一个包头
+        out.reserve(static_cast<std::size_t>(end - begin) *
+                    (width_ * bytespp_ + (width_ + kMaxPacketPixels - 1) /
+                                             kMaxPacketPixels));
+        std::vector<std::uint64_t> eq((width_ + 63) / 64);
+        for (int y = begin; y < end; ++y) {
+          const std::uint8_t* row =
+              data_.data() + static_cast<std::size_t>(y) * width_ * bytespp_;
+          kEqualMask[bytespp_](row, width_, bytespp_, eq.data());
+          EncodeRow(row, width_, bytespp_, eq.data(), &out);
+        }
+      });
+  return bands;
 }
 
-bool TgaImage::DecompressRLE(std::ifstream& in, const std::size_t bytes_num,
-                             const int bytespp) {
-  int cur_byte_loc = 0;
-  char temp;
-  std::uint32_t pixel;
-  while (cur_byte_loc < bytes_num) {
-    in.read(&temp, 1);
-    if (!in.good()) {
+bool TgaImage::DecompressRLE(const std::uint8_t* packets, std::size_t size,
+                             std::size_t bytes_num, int bytespp) {
+  data_.resize(bytes_num);
+  const std::uint8_t* p = packets;
+  const std::uint8_t* end = packets + size;
+  std::uint8_t* out = data_.data();
+  std::uint8_t* out_end = out + bytes_num;
+  while (out < out_end) {
+    if (p >= end) {
       std::cerr << "An error occurred while decompressing RLE (reading packet "
                    "mode).\n";
       return false;
     }
-    int n = (temp & 0x7F) + 1;  // 0x7F = 01111111 = 127
-    if (temp & 0x80) {
-      in.read(reinterpret_cast<char*>(&pixel), bytespp);
-      if (!in.good()) {
+    std::uint8_t packet = *p++;
+    std::size_t length = ((packet & 0x7F) + 1) * bytespp;  // 0x7F = 01111111
+    if (length > static_cast<std::size_t>(out_end - out)) {
+      std::cerr << "An error occurred while decompressing RLE (packet exceeds "
+                   "image size).\n";
+      return false;
+    }
+    if (packet & 0x80) {
+      if (end - p < bytespp) {
         std::cerr << "An error occurred while decompressing RLE (reading "
                      "compressed pixel packet).\n";
         return false;
       }
-      for (int i = 0; i < n; ++i) {
-        std::memcpy(&data_[cur_byte_loc], &pixel, bytespp);
-        cur_byte_loc += bytespp;
-      }
+      FillPixels(p, bytespp, length, out);
+      p += bytespp;
     } else {
-      in.read(reinterpret_cast<char*>(&data_[cur_byte_loc]), n * bytespp);
-      cur_byte_loc += n * bytespp;
-      if (!in.good()) {
+      if (static_cast<std::size_t>(end - p) < length) {
         std::cerr << "An error occurred while decompressing RLE (reading "
                      "uncompressed pixel packet).\n";
         return false;
       }
+      std::memcpy(out, p, length);
+      p += length;
     }
+    out += length;
   }
   return true;
 }
 
-bool TgaImage::FlipHorizontally() {
-  std::cerr << "flip horizontally.\n";
+bool TgaImage::FlipHorizontally(ThreadPool* pool) {
+  if (data_.empty()) return false;
+  static const ReverseRowFunc kReverseRow[5] = {
+      nullptr, GetReverseRowFunc(1), GetReverseRowFunc(2),
+      GetReverseRowFunc(3), GetReverseRowFunc(4)};
+  std::size_t stride = static_cast<std::size_t>(width_) * bytespp_;
+  ForEachRowBand(height_, GetRowBandNum(height_, data_.size(), pool), pool,
+                 [this, stride](int, int begin, int end) {
+                   for (int y = begin; y < end; ++y) {
+                     kReverseRow[bytespp_](data_.data() + y * stride, width_,
+                                           bytespp_);
+                   }
+                 });
   return true;
 }
-bool TgaImage::FlipVertically() {
-  std::cerr << "flip vertically.\n";
+
+bool TgaImage::FlipVertically(ThreadPool* pool) {
+  if (data_.empty()) return false;
+  std::size_t stride = static_cast<std::size_t>(width_) * bytespp_;
+  // 第y行与第height_-1-y行交换，按上半部分的行划分行带
+  ForEachRowBand(height_ / 2, GetRowBandNum(height_ / 2, data_.size(), pool),
+                 pool, [this, stride](int, int begin, int end) {
+                   std::vector<std::uint8_t> buffer(stride);
+                   for (int y = begin; y < end; ++y) {
+                     std::uint8_t* a = data_.data() + y * stride;
+                     std::uint8_t* b = data_.data() + (height_ - 1 - y) * stride;
+                     std::memcpy(buffer.data(), a, stride);
+                     std::memcpy(a, b, stride);
+                     std::memcpy(b, buffer.data(), stride);
+                   }
+                 });
   return true;
 }
 
+void TgaImage::ResolveOrientation(ThreadPool* pool) {
+  if (stored_flip_horizontal_) FlipHorizontally(pool);
+  if (stored_flip_vertical_) FlipVertically(pool);
+  stored_flip_horizontal_ = false;
+  stored_flip_vertical_ = false;
+}
+
 void TgaImage::SetColor(int x, int y, const TgaColor& color) {
   if (data_.empty() || x < 0 || y < 0 || x >= width_ || y >= height_) return;
+  if (stored_flip_horizontal_) x = width_ - 1 - x;
+  if (stored_flip_vertical_) y = height_ - 1 - y;
   std::memcpy(data_.data() + (x + y * width_) * bytespp_, &color, bytespp_);
 }
 
+void TgaImage::Clear() { std::fill(data_.begin(), data_.end(), 0); }
+
 TgaColor TgaImage::GetColor(int x, int y) const {
   if (data_.empty() || x < 0 || y < 0 || x >= width_ || y >= height_)
     return TgaColor(255, 255, 255, 255);
+  if (stored_flip_horizontal_) x = width_ - 1 - x;
+  if (stored_flip_vertical_) y = height_ - 1 - y;
   TgaColor color;
   for (int i = 0; i < bytespp_; ++i) {
     color[i] = data_[(x + y * width_) * bytespp_ + i];
@@ -0,0 +1,155 @@
+#include "include/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+// 当前线程所属的线程池及其队列下标，非工作线程为nullptr/-1
+thread_local ThreadPool* tls_pool = nullptr;
+thread_local int tls_queue_index = -1;
+}  // namespace
+
+ThreadPool::ThreadPool(int thread_num) {
+  if (thread_num <= 0) {
+    thread_num = static_cast<int>(std::thread::hardware_concurrency());
+    if (thread_num <= 0) thread_num = 1;
+  }
+  for (int i = 0; i < thread_num; ++i) {
+    queues_.push_back(std::make_unique<WorkQueue>());
+  }
+  for (int i = 0; i < thread_num; ++i) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+int ThreadPool::GetThreadNum() const {
+  return static_cast<int>(threads_.size());
+}
+
+ThreadPool& ThreadPool::Global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+  int queue_num = static_cast<int>(queues_.size());
+  int index = (this == tls_pool && 0 <= tls_queue_index)
+                  ? tls_queue_index
+                  : static_cast<int>(next_queue_++ % queue_num);
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++queued_;
+  }
+  cv_.notify_one();
+}
+
+bool ThreadPool::Pop(int queue_index, std::function<void()>& task) {
+  int queue_num = static_cast<int>(queues_.size());
+  if (0 == queued_.load()) return false;
+  if (0 <= queue_index) {
+    WorkQueue& own = *queues_[queue_index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+  int start = queue_index < 0 ? 0 : queue_index + 1;
+  for (int i = 0; i < queue_num; ++i) {
+    WorkQueue& victim = *queues_[(start + i) % queue_num];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int index) {
+  tls_pool = this;
+  tls_queue_index = index;
+  std::function<void()> task;
+  while (true) {
+    if (Pop(index, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return stop_ || 0 < queued_.load(); });
+    if (stop_ && 0 == queued_.load()) return;
+  }
+}
+
+void ThreadPool::ParallelFor(int begin, int end,
+                             const std::function<void(int)>& func) {
+  if (end <= begin) return;
+  if (1 == end - begin) {
+    func(begin);
+    return;
+  }
+  // 计数在锁内递减，保证等待方返回后不会再有任务访问这些局部变量
+  int remaining = end - begin;
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  for (int i = begin; i < end; ++i) {
+    Push([&, i] {
+      func(i);
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if (0 == --remaining) done_cv.notify_all();
+    });
+  }
+
+  int queue_index = this == tls_pool ? tls_queue_index : -1;
+  std::function<void()> task;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if (0 == remaining) break;
+    }
+    if (Pop(queue_index, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&remaining] { return 0 == remaining; });
+    break;
+  }
+}
+
+int GetRowBandNum(int row_num, std::size_t bytes, ThreadPool* pool,
+                  int min_band_rows, int max_band_num) {
+  if (!pool || bytes < kMinParallelRowBytes) return 1;
+  int band_num = std::min((pool->GetThreadNum() + 1) * kRowBandsPerThread,
+                          max_band_num);
+  min_band_rows = std::max(1, min_band_rows);
+  band_num = std::min(band_num, (row_num + min_band_rows - 1) / min_band_rows);
+  return std::max(1, band_num);
+}
@@ -0,0 +1,109 @@
+#include "include/transform.h"
+
+#include <algorithm>
+
+#include "include/geometry.h"
+#include "include/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// 每个并行任务处理的点数
+const int kChunkSize = 4096;
+// 点数不少于该值时才分段并行，较少的点直接在当前线程计算
+const int kParallelThreshold = 4 * kChunkSize;
+
+struct TransformJob {
+  double m[4][4];
+  transform_m::ConstPointSpan in;
+  transform_m::PointSpan out;
+};
+
+void TransformScalar(const TransformJob& job, int begin, int end) {
+  const transform_m::ConstPointSpan& in = job.in;
+  const transform_m::PointSpan& out = job.out;
+  for (int i = begin; i < end; ++i) {
+    double x = in.x[i];
+    double y = in.y[i];
+    double z = in.z[i];
+    double c[4];
+    for (int r = 0; r < 4; ++r) {
+      const double* m = job.m[r];
+      c[r] = m[0] * x + m[1] * y + m[2] * z + (in.w ? m[3] * in.w[i] : m[3]);
+    }
+    out.x[i] = c[0];
+    out.y[i] = c[1];
+    out.z[i] = c[2];
+    out.w[i] = c[3];
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 与TransformScalar逐位一致：相同的运算顺序，乘加分开计算
+__attribute__((target("avx2"))) void TransformAvx2(const TransformJob& job,
+                                                   int begin, int end) {
+  const transform_m::ConstPointSpan& in = job.in;
+  const transform_m::PointSpan& out = job.out;
+  __m256d m[4][4];
+  for (int r = 0; r < 4; ++r) {
+    for (int k = 0; k < 4; ++k) m[r][k] = _mm256_set1_pd(job.m[r][k]);
+  }
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m256d x = _mm256_loadu_pd(in.x + i);
+    __m256d y = _mm256_loadu_pd(in.y + i);
+    __m256d z = _mm256_loadu_pd(in.z + i);
+    __m256d c[4];
+    for (int r = 0; r < 4; ++r) {
+      __m256d t = _mm256_add_pd(_mm256_mul_pd(m[r][0], x),
+                                _mm256_mul_pd(m[r][1], y));
+      t = _mm256_add_pd(t, _mm256_mul_pd(m[r][2], z));
+      c[r] = _mm256_add_pd(
+          t, in.w ? _mm256_mul_pd(m[r][3], _mm256_loadu_pd(in.w + i))
+                  : m[r][3]);
+    }
+    _mm256_storeu_pd(out.x + i, c[0]);
+    _mm256_storeu_pd(out.y + i, c[1]);
+    _mm256_storeu_pd(out.z + i, c[2]);
+    _mm256_storeu_pd(out.w + i, c[3]);
+  }
+  TransformScalar(job, i, end);
+}
+#endif
+
+using TransformKernel = void (*)(const TransformJob&, int, int);
+
+TransformKernel GetTransformKernel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return TransformAvx2;
+#endif
+  return TransformScalar;
+}
+
+void Run(const TransformJob& job, int count, ThreadPool* pool) {
+  static const TransformKernel kernel = GetTransformKernel();
+  if (!pool || count < kParallelThreshold) {
+    kernel(job, 0, count);
+    return;
+  }
+  int chunk_num = (count + kChunkSize - 1) / kChunkSize;
+  pool->ParallelFor(0, chunk_num, [&job, count](int chunk) {
+    int begin = chunk * kChunkSize;
+    kernel(job, begin, std::min(count, begin + kChunkSize));
+  });
+}
+}  // namespace
+
+void transform_m::Transform(const SMatrix4& m, const ConstPointSpan& in,
+                            int count, const PointSpan& out, ThreadPool* pool) {
+  TransformJob job;
+  for (int r = 0; r < 4; ++r) {
+    for (int k = 0; k < 4; ++k) job.m[r][k] = m(r, k);
+  }
+  job.in = in;
+  job.out = out;
+  Run(job, count, pool);
+}
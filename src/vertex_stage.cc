@@ -0,0 +1,40 @@
+#include "include/vertex_stage.h"
+
+#include <cstddef>
+#include <vector>
+
+#include "include/geometry.h"
+#include "include/indexed_mesh.h"
+#include "include/thread_pool.h"
+#include "include/transform.h"
+
+VertexStage::VertexStage(const IndexedMesh& mesh, ThreadPool* pool)
+    : pool_(pool) {
+  int vertex_num = mesh.GetVertexNum();
+  x_.resize(vertex_num);
+  y_.resize(vertex_num);
+  z_.resize(vertex_num);
+  for (int i = 0; i < vertex_num; ++i) {
+    const double* position = mesh.GetVertex(i).position;
+    x_[i] = position[0];
+    y_[i] = position[1];
+    z_[i] = position[2];
+  }
+  clip_x_.resize(vertex_num);
+  clip_y_.resize(vertex_num);
+  clip_z_.resize(vertex_num);
+  clip_w_.resize(vertex_num);
+}
+
+VertexStage::~VertexStage() = default;
+
+std::size_t VertexStage::GetVertexNum() const { return x_.size(); }
+
+void VertexStage::Process(const SMatrix4& mvp) {
+  transform_m::Transform(
+      mvp, transform_m::ConstPointSpan{x_.data(), y_.data(), z_.data(), nullptr},
+      static_cast<int>(x_.size()),
+      transform_m::PointSpan{clip_x_.data(), clip_y_.data(), clip_z_.data(),
+                             clip_w_.data()},
+      pool_);
+}
@@ -0,0 +1,83 @@
+// 检查非TGA编码器对尚未应用的翻转(ReadTgaFile(..., false))的处理：
+// 以各种翻转组合写出灰度、RGB、RGBA图像，分别以应用与不应用翻转的方式
+// 读回，两者经Raw/PPM/PNG编码的结果必须逐字节相同。
+// 建议在AddressSanitizer下运行，可以发现转换行时的越界写。
+//
+// 在仓库根目录编译运行：
+//   g++ -std=c++17 -O1 -g -fsanitize=address -I. test/image_encoder_test.cc
+//     $(ls src/*.cc | grep -v main) -o image_encoder_test -pthread
+//   ./image_encoder_test [临时文件目录]
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include "include/image_encoder.h"
+#include "include/tga_image.h"
+#include "include/thread_pool.h"
+
+namespace {
+std::string ReadFile(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string dir = 1 < argc ? argv[1] : "/tmp";
+  const std::string tga_filename = dir + "/image_encoder_test.tga";
+  RawEncoder raw;
+  PpmEncoder ppm;
+  PngEncoder png;
+  const ImageEncoder* encoders[] = {&raw, &ppm, &png};
+  // 宽度取奇数，行的字节数不是4的倍数
+  const int sizes[][2] = {{7, 3}, {1, 1}, {33, 17}};
+  std::mt19937 rng(1);
+  int fail_num = 0;
+  for (int bytespp : {TgaImage::kGrayscale, TgaImage::kRGB, TgaImage::kRGBA}) {
+    for (const int* size : sizes) {
+      for (int flip = 0; flip < 4; ++flip) {
+        TgaImage image(size[0], size[1], bytespp);
+        for (int y = 0; y < size[1]; ++y) {
+          for (int x = 0; x < size[0]; ++x) {
+            image.SetColor(x, y, TgaColor(rng(), rng(), rng(), rng()));
+          }
+        }
+        if (!image.WriteTgaFile(tga_filename, flip & 1, flip & 2, false)) {
+          return 1;
+        }
+        TgaImage resolved;
+        TgaImage stored;
+        if (!resolved.ReadTgaFile(tga_filename, true) ||
+            !stored.ReadTgaFile(tga_filename, false)) {
+          return 1;
+        }
+        for (ThreadPool* pool : {static_cast<ThreadPool*>(nullptr),
+                                 &ThreadPool::Global()}) {
+          for (const ImageEncoder* encoder : encoders) {
+            std::string prefix = dir + "/image_encoder_test.";
+            std::string expected_filename =
+                prefix + "resolved." + encoder->GetExtension();
+            std::string actual_filename =
+                prefix + "stored." + encoder->GetExtension();
+            if (!encoder->Write(resolved, expected_filename, pool) ||
+                !encoder->Write(stored, actual_filename, pool)) {
+              return 1;
+            }
+            if (ReadFile(expected_filename) != ReadFile(actual_filename)) {
+              std::cerr << encoder->GetExtension() << " mismatch: bytespp "
+                        << bytespp << ", " << size[0] << "x" << size[1]
+                        << ", horizontal flip " << (flip & 1)
+                        << ", vertical flip " << (flip >> 1) << ".\n";
+              ++fail_num;
+            }
+          }
+        }
+      }
+    }
+  }
+  std::cout << (fail_num ? "FAILED" : "PASSED") << "\n";
+  return fail_num ? 1 : 0;
+}